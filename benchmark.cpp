@@ -0,0 +1,1035 @@
+#include "spirv-interface.h"
+#include "spirv-archive.h"
+#include "spirv-cache.h"
+#include "spirv-codegen.h"
+#include "spirv-pipeline.h"
+#include "spirv-block-map.h"
+#include <vulkan/spirv.hpp11>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <new>
+#include <thread>
+#include <tuple>
+
+// Heap use of the whole process, tracked by the replacement operator new and operator delete below
+namespace heap
+{
+    std::atomic<size_t> allocation_count {0}, live_bytes {0}, peak_bytes {0};
+
+    // Starts a new measurement, returning the bytes already live so that the peak can be reported relative to them
+    size_t reset() { allocation_count = 0; return peak_bytes = live_bytes.load(); }
+}
+
+void * operator new(size_t size)
+{
+    // Each allocation is preceded by its size, so that operator delete knows how many bytes are no longer live
+    auto * p = static_cast<char *>(malloc(size + sizeof(std::max_align_t)));
+    if(!p) throw std::bad_alloc();
+    *reinterpret_cast<size_t *>(p) = size;
+    ++heap::allocation_count;
+    const size_t live = heap::live_bytes += size;
+    for(size_t peak = heap::peak_bytes; live > peak && !heap::peak_bytes.compare_exchange_weak(peak, live); ) {}
+    return p + sizeof(std::max_align_t);
+}
+
+void operator delete(void * p) noexcept
+{
+    if(!p) return;
+    auto * q = static_cast<char *>(p) - sizeof(std::max_align_t);
+    heap::live_bytes -= *reinterpret_cast<size_t *>(q);
+    free(q);
+}
+
+void operator delete(void * p, size_t) noexcept { operator delete(p); }
+
+// Helper for assembling synthetic SPIR-V modules
+struct module_builder
+{
+    std::vector<uint32_t> words {0x07230203, 0x00010000, 0, 1, 0};
+
+    uint32_t id() { return words[3]++; }
+
+    void emit(spv::Op op_code, std::vector<uint32_t> operands, const char * string = nullptr, std::vector<uint32_t> trailing_operands = {})
+    {
+        if(string)
+        {
+            const size_t length = strlen(string), string_words = length/4+1, first = operands.size();
+            operands.resize(first + string_words, 0);
+            memcpy(operands.data() + first, string, length);
+        }
+        operands.insert(end(operands), begin(trailing_operands), end(trailing_operands));
+        words.push_back(static_cast<uint32_t>((operands.size()+1) << 16 | static_cast<uint32_t>(op_code)));
+        words.insert(end(words), begin(operands), end(operands));
+    }
+};
+
+// The dimensions along which synthetic modules can be scaled
+struct module_shape
+{
+    size_t block_count = 0;             // Uniform blocks, each with its own struct type containing a nested light struct array
+    size_t body_instruction_count = 0;  // Instructions within a function body, which reflection should skip over
+    size_t nesting_depth = 0;           // Depth of a chain of nested structs appended to every block
+    size_t entry_point_count = 0;       // Vertex entry points, each with its own function and four inputs and outputs
+    size_t unused_block_count = 0;      // Uniform block types which no variable refers to, with their names and decorations, as left behind when a block is compiled out
+    bool specialize_light_count = false;
+    bool debug_info = false;            // The shader source and line information, as emitted by compilers when debugging
+};
+
+// Generates a module of the given shape, with the instructions grouped into the logical layout sections mandated by the SPIR-V specification.
+// If specialize_light_count is set, the light array holds one more light than the value of specialization constant 0, which defaults to 3.
+std::vector<uint32_t> generate_module(const module_shape & shape)
+{
+    module_builder entry_points, debug, names, annotations, types, functions;
+    const uint32_t t_float = types.id(), t_uint = types.id(), t_vec4 = types.id(), t_mat4 = types.id(), c_light_count = types.id(), t_light = types.id(), t_light_array = types.id();
+    types.emit(spv::Op::OpTypeFloat, {t_float, 32});
+    types.emit(spv::Op::OpTypeInt, {t_uint, 32, 0});
+    types.emit(spv::Op::OpTypeVector, {t_vec4, t_float, 4});
+    types.emit(spv::Op::OpTypeMatrix, {t_mat4, t_vec4, 4});
+    if(shape.specialize_light_count)
+    {
+        const uint32_t c_max_lights = types.id(), c_one = types.id();
+        types.emit(spv::Op::OpSpecConstant, {t_uint, c_max_lights, 3});
+        types.emit(spv::Op::OpConstant, {t_uint, c_one, 1});
+        types.emit(spv::Op::OpSpecConstantOp, {t_uint, c_light_count, static_cast<uint32_t>(spv::Op::OpIAdd), c_max_lights, c_one});
+        names.emit(spv::Op::OpName, {c_max_lights}, "MAX_LIGHTS");
+        annotations.emit(spv::Op::OpDecorate, {c_max_lights, static_cast<uint32_t>(spv::Decoration::SpecId), 0});
+    }
+    else types.emit(spv::Op::OpConstant, {t_uint, c_light_count, 4});
+    types.emit(spv::Op::OpTypeStruct, {t_light, t_vec4, t_vec4});
+    types.emit(spv::Op::OpTypeArray, {t_light_array, t_light, c_light_count});
+    names.emit(spv::Op::OpName, {t_light}, "light");
+    names.emit(spv::Op::OpMemberName, {t_light, 0}, "position");
+    names.emit(spv::Op::OpMemberName, {t_light, 1}, "color");
+    annotations.emit(spv::Op::OpMemberDecorate, {t_light, 0, static_cast<uint32_t>(spv::Decoration::Offset), 0});
+    annotations.emit(spv::Op::OpMemberDecorate, {t_light, 1, static_cast<uint32_t>(spv::Decoration::Offset), 16});
+    annotations.emit(spv::Op::OpDecorate, {t_light_array, static_cast<uint32_t>(spv::Decoration::ArrayStride), 32});
+
+    // The source is a line per block, which the function body refers to by line number
+    const uint32_t s_file = shape.debug_info ? types.id() : 0;
+    if(shape.debug_info)
+    {
+        std::string source = "#version 450\n";
+        for(size_t i=0; i<shape.block_count; ++i) source += "layout(set=" + std::to_string(i % 4) + ", binding=" + std::to_string(i / 4) + ") uniform block" + std::to_string(i) + " { mat4 transform; vec4 tint; float intensity; light lights[4]; } u_block" + std::to_string(i) + ";\n";
+        debug.emit(spv::Op::OpString, {s_file}, "shader.frag");
+        debug.emit(spv::Op::OpSource, {static_cast<uint32_t>(spv::SourceLanguage::GLSL), 450, s_file}, source.c_str());
+    }
+
+    // Each level of nesting wraps the previous level along with a float, starting from a single vec4
+    uint32_t t_nested = t_vec4;
+    for(size_t depth=0; depth<shape.nesting_depth; ++depth)
+    {
+        const uint32_t t_level = types.id();
+        types.emit(spv::Op::OpTypeStruct, {t_level, t_nested, t_float});
+        names.emit(spv::Op::OpName, {t_level}, ("level" + std::to_string(depth)).c_str());
+        names.emit(spv::Op::OpMemberName, {t_level, 0}, "inner");
+        names.emit(spv::Op::OpMemberName, {t_level, 1}, "weight");
+        annotations.emit(spv::Op::OpMemberDecorate, {t_level, 0, static_cast<uint32_t>(spv::Decoration::Offset), 0});
+        annotations.emit(spv::Op::OpMemberDecorate, {t_level, 1, static_cast<uint32_t>(spv::Decoration::Offset), static_cast<uint32_t>(16 * (depth + 1))});
+        t_nested = t_level;
+    }
+
+    for(size_t i=0; i<shape.block_count; ++i)
+    {
+        const uint32_t t_block = types.id(), t_pointer = types.id(), v_block = types.id();
+        if(shape.nesting_depth) types.emit(spv::Op::OpTypeStruct, {t_block, t_mat4, t_vec4, t_float, t_light_array, t_nested});
+        else types.emit(spv::Op::OpTypeStruct, {t_block, t_mat4, t_vec4, t_float, t_light_array});
+        types.emit(spv::Op::OpTypePointer, {t_pointer, static_cast<uint32_t>(spv::StorageClass::Uniform), t_block});
+        types.emit(spv::Op::OpVariable, {t_pointer, v_block, static_cast<uint32_t>(spv::StorageClass::Uniform)});
+
+        const std::string name = "block" + std::to_string(i);
+        names.emit(spv::Op::OpName, {t_block}, name.c_str());
+        names.emit(spv::Op::OpMemberName, {t_block, 0}, "transform");
+        names.emit(spv::Op::OpMemberName, {t_block, 1}, "tint");
+        names.emit(spv::Op::OpMemberName, {t_block, 2}, "intensity");
+        names.emit(spv::Op::OpMemberName, {t_block, 3}, "lights");
+        names.emit(spv::Op::OpName, {v_block}, ("u_" + name).c_str());
+
+        uint32_t offset = 0;
+        for(uint32_t m : {0, 1, 2, 3})
+        {
+            annotations.emit(spv::Op::OpMemberDecorate, {t_block, m, static_cast<uint32_t>(spv::Decoration::Offset), offset});
+            offset += m == 0 ? 64 : 16;
+        }
+        if(shape.nesting_depth)
+        {
+            // The nested member follows the light array at its default length
+            names.emit(spv::Op::OpMemberName, {t_block, 4}, "nested");
+            annotations.emit(spv::Op::OpMemberDecorate, {t_block, 4, static_cast<uint32_t>(spv::Decoration::Offset), offset + 4*32});
+        }
+        annotations.emit(spv::Op::OpMemberDecorate, {t_block, 0, static_cast<uint32_t>(spv::Decoration::ColMajor)});
+        annotations.emit(spv::Op::OpMemberDecorate, {t_block, 0, static_cast<uint32_t>(spv::Decoration::MatrixStride), 16});
+        annotations.emit(spv::Op::OpDecorate, {t_block, static_cast<uint32_t>(spv::Decoration::Block)});
+        annotations.emit(spv::Op::OpDecorate, {v_block, static_cast<uint32_t>(spv::Decoration::DescriptorSet), static_cast<uint32_t>(i % 4)});
+        annotations.emit(spv::Op::OpDecorate, {v_block, static_cast<uint32_t>(spv::Decoration::Binding), static_cast<uint32_t>(i / 4)});
+    }
+
+    for(size_t i=0; i<shape.unused_block_count; ++i)
+    {
+        const uint32_t t_block = types.id(), t_pointer = types.id();
+        types.emit(spv::Op::OpTypeStruct, {t_block, t_mat4, t_vec4, t_float});
+        types.emit(spv::Op::OpTypePointer, {t_pointer, static_cast<uint32_t>(spv::StorageClass::Uniform), t_block});
+        names.emit(spv::Op::OpName, {t_block}, ("unused" + std::to_string(i)).c_str());
+        names.emit(spv::Op::OpMemberName, {t_block, 0}, "transform");
+        names.emit(spv::Op::OpMemberName, {t_block, 1}, "tint");
+        names.emit(spv::Op::OpMemberName, {t_block, 2}, "intensity");
+        for(uint32_t m : {0, 1, 2}) annotations.emit(spv::Op::OpMemberDecorate, {t_block, m, static_cast<uint32_t>(spv::Decoration::Offset), m == 0 ? 0u : 48 + m*16});
+        annotations.emit(spv::Op::OpMemberDecorate, {t_block, 0, static_cast<uint32_t>(spv::Decoration::MatrixStride), 16});
+        annotations.emit(spv::Op::OpDecorate, {t_block, static_cast<uint32_t>(spv::Decoration::Block)});
+    }
+
+    if(shape.body_instruction_count || shape.entry_point_count)
+    {
+        const uint32_t t_void = types.id(), t_function = types.id();
+        types.emit(spv::Op::OpTypeVoid, {t_void});
+        types.emit(spv::Op::OpTypeFunction, {t_function, t_void});
+        if(shape.body_instruction_count)
+        {
+            const uint32_t c_one = types.id(), f_main = types.id(), l_entry = types.id();
+            types.emit(spv::Op::OpConstant, {t_float, c_one, 0x3F800000});
+            functions.emit(spv::Op::OpFunction, {t_void, f_main, 0, t_function});
+            functions.emit(spv::Op::OpLabel, {l_entry});
+            uint32_t value = c_one;
+            for(size_t i=0; i<shape.body_instruction_count; ++i)
+            {
+                const uint32_t sum = types.id();
+                if(shape.debug_info) functions.emit(spv::Op::OpLine, {s_file, static_cast<uint32_t>(2 + i % (shape.block_count + 1)), 1});
+                functions.emit(spv::Op::OpFAdd, {t_float, sum, value, c_one});
+                value = sum;
+            }
+            functions.emit(spv::Op::OpReturn, {});
+            functions.emit(spv::Op::OpFunctionEnd, {});
+        }
+        if(shape.entry_point_count)
+        {
+            const uint32_t t_input = types.id(), t_output = types.id();
+            types.emit(spv::Op::OpTypePointer, {t_input, static_cast<uint32_t>(spv::StorageClass::Input), t_vec4});
+            types.emit(spv::Op::OpTypePointer, {t_output, static_cast<uint32_t>(spv::StorageClass::Output), t_vec4});
+            for(size_t i=0; i<shape.entry_point_count; ++i)
+            {
+                const uint32_t f_entry = types.id(), l_entry = types.id();
+                std::vector<uint32_t> interface;
+                for(uint32_t location=0; location<8; ++location)
+                {
+                    const uint32_t v = types.id();
+                    types.emit(spv::Op::OpVariable, {location < 4 ? t_input : t_output, v, static_cast<uint32_t>(location < 4 ? spv::StorageClass::Input : spv::StorageClass::Output)});
+                    names.emit(spv::Op::OpName, {v}, ((location < 4 ? "in" : "out") + std::to_string(location % 4)).c_str());
+                    annotations.emit(spv::Op::OpDecorate, {v, static_cast<uint32_t>(spv::Decoration::Location), location % 4});
+                    interface.push_back(v);
+                }
+                entry_points.emit(spv::Op::OpEntryPoint, {static_cast<uint32_t>(spv::ExecutionModel::Vertex), f_entry}, ("main" + std::to_string(i)).c_str(), interface);
+                functions.emit(spv::Op::OpFunction, {t_void, f_entry, 0, t_function});
+                functions.emit(spv::Op::OpLabel, {l_entry});
+                functions.emit(spv::Op::OpReturn, {});
+                functions.emit(spv::Op::OpFunctionEnd, {});
+            }
+        }
+    }
+
+    module_builder m;
+    m.words[3] = types.words[3];
+    for(auto * section : {&entry_points, &debug, &names, &annotations, &types, &functions}) m.words.insert(end(m.words), begin(section->words)+5, end(section->words));
+    return m.words;
+}
+
+std::vector<uint32_t> generate_uniform_module(size_t block_count, size_t body_instruction_count = 0, bool specialize_light_count = false)
+{
+    module_shape shape;
+    shape.block_count = block_count;
+    shape.body_instruction_count = body_instruction_count;
+    shape.specialize_light_count = specialize_light_count;
+    return generate_module(shape);
+}
+
+// Generates one of the permutations of a shader whose preprocessor definitions select the number of blocks, their nesting, and the entry points.
+// Every permutation below 5120 is distinct, while sharing most of its types and names with the others.
+std::vector<uint32_t> generate_permutation(uint32_t permutation)
+{
+    module_shape shape;
+    shape.block_count = 12 + permutation % 16;
+    shape.nesting_depth = permutation / 16 % 4 * 2;
+    shape.specialize_light_count = permutation / 64 % 2 != 0;
+    shape.entry_point_count = 1 + permutation / 128 % 40;
+    return generate_module(shape);
+}
+
+// Generates a module whose vertex and compute entry points share one of each kind of descriptor other than a uniform block, along with two push
+// constant blocks, the first of which holds a row-major matrix. The descriptors of set 0 are, by binding:
+//   0: a BufferBlock holding a count and a runtime array of particles, 1: a storage image, 2: a sampled image, 3: a separate sampler,
+//   4: a runtime array of sampled images, 5: a StorageBuffer block holding a runtime array of floats
+std::vector<uint32_t> generate_resource_module()
+{
+    module_builder entry_points, names, annotations, types, functions;
+    const uint32_t t_void = types.id(), t_function = types.id(), t_float = types.id(), t_uint = types.id(), t_vec4 = types.id(), t_mat3x4 = types.id();
+    types.emit(spv::Op::OpTypeVoid, {t_void});
+    types.emit(spv::Op::OpTypeFunction, {t_function, t_void});
+    types.emit(spv::Op::OpTypeFloat, {t_float, 32});
+    types.emit(spv::Op::OpTypeInt, {t_uint, 32, 0});
+    types.emit(spv::Op::OpTypeVector, {t_vec4, t_float, 4});
+    types.emit(spv::Op::OpTypeMatrix, {t_mat3x4, t_vec4, 3});
+
+    auto decorate = [&](uint32_t id, spv::Decoration decoration, std::vector<uint32_t> operands = {}) { operands.insert(begin(operands), {id, static_cast<uint32_t>(decoration)}); annotations.emit(spv::Op::OpDecorate, operands); };
+    auto decorate_member = [&](uint32_t id, uint32_t member, spv::Decoration decoration, std::vector<uint32_t> operands = {}) { operands.insert(begin(operands), {id, member, static_cast<uint32_t>(decoration)}); annotations.emit(spv::Op::OpMemberDecorate, operands); };
+    auto declare_variable = [&](uint32_t type, spv::StorageClass storage_class, const char * name, uint32_t binding)
+    {
+        const uint32_t t_pointer = types.id(), v = types.id();
+        types.emit(spv::Op::OpTypePointer, {t_pointer, static_cast<uint32_t>(storage_class), type});
+        types.emit(spv::Op::OpVariable, {t_pointer, v, static_cast<uint32_t>(storage_class)});
+        names.emit(spv::Op::OpName, {v}, name);
+        if(storage_class == spv::StorageClass::PushConstant) return;
+        decorate(v, spv::Decoration::DescriptorSet, {0});
+        decorate(v, spv::Decoration::Binding, {binding});
+    };
+
+    const uint32_t t_particle = types.id(), t_particles = types.id(), t_particle_buffer = types.id();
+    types.emit(spv::Op::OpTypeStruct, {t_particle, t_vec4, t_vec4});
+    types.emit(spv::Op::OpTypeRuntimeArray, {t_particles, t_particle});
+    types.emit(spv::Op::OpTypeStruct, {t_particle_buffer, t_uint, t_particles});
+    names.emit(spv::Op::OpName, {t_particle}, "particle");
+    names.emit(spv::Op::OpMemberName, {t_particle, 0}, "position");
+    names.emit(spv::Op::OpMemberName, {t_particle, 1}, "velocity");
+    names.emit(spv::Op::OpName, {t_particle_buffer}, "particle_buffer");
+    names.emit(spv::Op::OpMemberName, {t_particle_buffer, 0}, "count");
+    names.emit(spv::Op::OpMemberName, {t_particle_buffer, 1}, "particles");
+    decorate_member(t_particle, 0, spv::Decoration::Offset, {0});
+    decorate_member(t_particle, 1, spv::Decoration::Offset, {16});
+    decorate(t_particles, spv::Decoration::ArrayStride, {32});
+    decorate_member(t_particle_buffer, 0, spv::Decoration::Offset, {0});
+    decorate_member(t_particle_buffer, 1, spv::Decoration::Offset, {16});
+    decorate(t_particle_buffer, spv::Decoration::BufferBlock);
+    declare_variable(t_particle_buffer, spv::StorageClass::Uniform, "u_particles", 0);
+
+    // Images are 2D, non-arrayed and single-sampled, and the storage image has format Rgba32f
+    const uint32_t t_storage_image = types.id(), t_texture = types.id(), t_sampler = types.id(), t_textures = types.id();
+    types.emit(spv::Op::OpTypeImage, {t_storage_image, t_float, static_cast<uint32_t>(spv::Dim::Dim2D), 0, 0, 0, 2, static_cast<uint32_t>(spv::ImageFormat::Rgba32f)});
+    types.emit(spv::Op::OpTypeImage, {t_texture, t_float, static_cast<uint32_t>(spv::Dim::Dim2D), 0, 0, 0, 1, static_cast<uint32_t>(spv::ImageFormat::Unknown)});
+    types.emit(spv::Op::OpTypeSampler, {t_sampler});
+    types.emit(spv::Op::OpTypeRuntimeArray, {t_textures, t_texture});
+    declare_variable(t_storage_image, spv::StorageClass::UniformConstant, "u_output", 1);
+    declare_variable(t_texture, spv::StorageClass::UniformConstant, "u_texture", 2);
+    declare_variable(t_sampler, spv::StorageClass::UniformConstant, "u_sampler", 3);
+    declare_variable(t_textures, spv::StorageClass::UniformConstant, "u_textures", 4);
+
+    const uint32_t t_weights = types.id(), t_weight_buffer = types.id();
+    types.emit(spv::Op::OpTypeRuntimeArray, {t_weights, t_float});
+    types.emit(spv::Op::OpTypeStruct, {t_weight_buffer, t_weights});
+    names.emit(spv::Op::OpName, {t_weight_buffer}, "weight_buffer");
+    names.emit(spv::Op::OpMemberName, {t_weight_buffer, 0}, "weights");
+    decorate(t_weights, spv::Decoration::ArrayStride, {4});
+    decorate_member(t_weight_buffer, 0, spv::Decoration::Offset, {0});
+    decorate(t_weight_buffer, spv::Decoration::Block);
+    declare_variable(t_weight_buffer, spv::StorageClass::StorageBuffer, "u_weights", 5);
+
+    // The first block spans bytes [0,80), as its row-major matrix takes four rows of 16 bytes, and the second spans bytes [96,100)
+    const uint32_t t_transform = types.id(), t_scale = types.id();
+    types.emit(spv::Op::OpTypeStruct, {t_transform, t_vec4, t_mat3x4});
+    types.emit(spv::Op::OpTypeStruct, {t_scale, t_float});
+    names.emit(spv::Op::OpName, {t_transform}, "transform_constants");
+    names.emit(spv::Op::OpMemberName, {t_transform, 0}, "tint");
+    names.emit(spv::Op::OpMemberName, {t_transform, 1}, "transform");
+    names.emit(spv::Op::OpName, {t_scale}, "scale_constants");
+    names.emit(spv::Op::OpMemberName, {t_scale, 0}, "scale");
+    decorate_member(t_transform, 0, spv::Decoration::Offset, {0});
+    decorate_member(t_transform, 1, spv::Decoration::Offset, {16});
+    decorate_member(t_transform, 1, spv::Decoration::RowMajor);
+    decorate_member(t_transform, 1, spv::Decoration::MatrixStride, {16});
+    decorate_member(t_scale, 0, spv::Decoration::Offset, {96});
+    decorate(t_transform, spv::Decoration::Block);
+    decorate(t_scale, spv::Decoration::Block);
+    declare_variable(t_transform, spv::StorageClass::PushConstant, "p_transform", 0);
+    declare_variable(t_scale, spv::StorageClass::PushConstant, "p_scale", 0);
+
+    const uint32_t f_main = types.id(), l_entry = types.id();
+    entry_points.emit(spv::Op::OpEntryPoint, {static_cast<uint32_t>(spv::ExecutionModel::Vertex), f_main}, "main");
+    entry_points.emit(spv::Op::OpEntryPoint, {static_cast<uint32_t>(spv::ExecutionModel::GLCompute), f_main}, "main");
+    entry_points.emit(spv::Op::OpExecutionMode, {f_main, static_cast<uint32_t>(spv::ExecutionMode::LocalSize), 64, 1, 1});
+    functions.emit(spv::Op::OpFunction, {t_void, f_main, 0, t_function});
+    functions.emit(spv::Op::OpLabel, {l_entry});
+    functions.emit(spv::Op::OpReturn, {});
+    functions.emit(spv::Op::OpFunctionEnd, {});
+
+    // The StorageBuffer storage class requires SPIR-V 1.3
+    module_builder m;
+    m.words[1] = 0x00010300;
+    m.words[3] = types.words[3];
+    for(auto * section : {&entry_points, &names, &annotations, &types, &functions}) m.words.insert(end(m.words), begin(section->words)+5, end(section->words));
+    return m.words;
+}
+
+// Finds the offset of a field by walking the members of a block and comparing names, as a baseline for block_map
+std::optional<size_t> find_field_offset(const spvi::type & block, const char * path)
+{
+    const spvi::type * t = &block;
+    size_t offset = 0;
+    while(*path)
+    {
+        if(*path == '.') ++path;
+        auto * s = std::get_if<spvi::type::structure>(&t->contents);
+        if(!s) return std::nullopt;
+        const size_t length = strcspn(path, ".[");
+        auto it = std::find_if(s->members.begin(), s->members.end(), [&](const spvi::type::structure::member & m) { return m.name == std::string(path, length); });
+        if(it == s->members.end()) return std::nullopt;
+        offset += it->offset.value_or(0);
+        t = &static_cast<const spvi::type &>(it->member_type);
+        for(path += length; *path == '['; path = strchr(path, ']') + 1)
+        {
+            auto * a = std::get_if<spvi::type::array>(&t->contents);
+            if(!a || !a->stride) return std::nullopt;
+            offset += strtoul(path + 1, nullptr, 10) * *a->stride;
+            t = &static_cast<const spvi::type &>(a->elem_type);
+        }
+    }
+    return offset;
+}
+
+// Generates the interface of an entry point, with one vector at each location whose width is chosen by two bits of the seed
+std::vector<spvi::variable_info> generate_interface(uint32_t seed, uint32_t count)
+{
+    std::vector<spvi::variable_info> variables;
+    for(uint32_t i=0; i<count; ++i)
+    {
+        const size_t row_count = 1 + (seed >> (i*2) & 3);
+        variables.push_back({i, spvi::type{spvi::type::numeric{spvi::type::float_, 32, row_count, 1, 4, 0}}, "v" + std::to_string(i)});
+    }
+    return variables;
+}
+
+// Finds the instructions which reflection decodes by walking the binary one instruction at a time, as a reference for index_instructions
+std::vector<uint32_t> find_reflected_instructions(const std::vector<uint32_t> & words)
+{
+    std::vector<uint32_t> offsets;
+    for(uint32_t i=5; i<words.size() && static_cast<spv::Op>(words[i] & spv::OpCodeMask) != spv::Op::OpFunction; i += words[i] >> 16)
+    {
+        switch(static_cast<spv::Op>(words[i] & spv::OpCodeMask))
+        {
+        case spv::Op::OpName: case spv::Op::OpMemberName: case spv::Op::OpEntryPoint:
+        case spv::Op::OpTypeVoid: case spv::Op::OpTypeBool: case spv::Op::OpTypeInt: case spv::Op::OpTypeFloat: case spv::Op::OpTypeVector: case spv::Op::OpTypeMatrix:
+        case spv::Op::OpTypeImage: case spv::Op::OpTypeSampler: case spv::Op::OpTypeSampledImage: case spv::Op::OpTypeArray: case spv::Op::OpTypeRuntimeArray:
+        case spv::Op::OpTypeStruct: case spv::Op::OpTypeOpaque: case spv::Op::OpTypePointer:
+        case spv::Op::OpConstantTrue: case spv::Op::OpConstantFalse: case spv::Op::OpConstant:
+        case spv::Op::OpSpecConstantTrue: case spv::Op::OpSpecConstantFalse: case spv::Op::OpSpecConstant: case spv::Op::OpSpecConstantOp:
+        case spv::Op::OpVariable: case spv::Op::OpDecorate: case spv::Op::OpMemberDecorate:
+            offsets.push_back(i);
+            break;
+        default: break;
+        }
+    }
+    return offsets;
+}
+
+// Copies a binary, leaving out every instruction for which drop(op_code, first_word) returns true
+template<class F> std::vector<uint32_t> remove_instructions(const std::vector<uint32_t> & words, F drop)
+{
+    std::vector<uint32_t> r(words.begin(), words.begin() + 5);
+    for(size_t i=5; i<words.size(); i += words[i] >> 16)
+    {
+        if(!drop(static_cast<spv::Op>(words[i] & spv::OpCodeMask), &words[i])) r.insert(r.end(), words.begin() + i, words.begin() + i + (words[i] >> 16));
+    }
+    return r;
+}
+
+// Removes debug names, as stripping tools do for shipping builds
+std::vector<uint32_t> strip_names(const std::vector<uint32_t> & words)
+{
+    return remove_instructions(words, [](spv::Op op_code, const uint32_t *) { return op_code == spv::Op::OpName || op_code == spv::Op::OpMemberName; });
+}
+
+// A binary which reflection must reject, along with the error it should report
+struct malformed_module
+{
+    const char * label;
+    std::vector<uint32_t> words;
+    spvi::reflection_errc code;
+    size_t word_offset;
+};
+
+// Corrupts a module with at least one entry point and interface variable in each of the ways which try_reflect distinguishes
+std::vector<malformed_module> generate_malformed_modules(const std::vector<uint32_t> & words)
+{
+    std::vector<uint32_t> offsets;
+    for(uint32_t i=5; i<words.size(); i += words[i] >> 16) offsets.push_back(i);
+    auto find_variable = [](const std::vector<uint32_t> & words)
+    {
+        uint32_t i = 5;
+        while(static_cast<spv::Op>(words[i] & spv::OpCodeMask) != spv::Op::OpVariable) i += words[i] >> 16;
+        return i;
+    };
+    std::vector<malformed_module> modules;
+
+    modules.push_back({"not SPIR-V", words, spvi::reflection_errc::not_spirv, 0});
+    modules.back().words[0] = 0x03022307;
+
+    // Reflection stops scanning at the first function, so the binary is truncated within the last declaration before it
+    const auto first_function = std::find_if(offsets.begin(), offsets.end(), [&](uint32_t i) { return static_cast<spv::Op>(words[i] & spv::OpCodeMask) == spv::Op::OpFunction; });
+    const uint32_t declarations_end = first_function == offsets.end() ? static_cast<uint32_t>(words.size()) : *first_function;
+    modules.push_back({"truncated", words, spvi::reflection_errc::malformed_instruction, *(first_function - 1)});
+    modules.back().words.resize(declarations_end - 1);
+
+    const uint32_t middle = offsets[offsets.size()/2];
+    modules.push_back({"zero length", words, spvi::reflection_errc::malformed_instruction, middle});
+    modules.back().words[middle] &= spv::OpCodeMask;
+
+    const uint32_t variable = find_variable(words);
+    modules.push_back({"id out of bounds", words, spvi::reflection_errc::invalid_id, variable});
+    modules.back().words[variable + 2] = words[3];
+
+    // A result ID equal to the largest possible word must be rejected like any other, rather than mistaken for an instruction without a result
+    const uint32_t structure = *std::find_if(offsets.begin(), offsets.end(), [&](uint32_t i) { return static_cast<spv::Op>(words[i] & spv::OpCodeMask) == spv::Op::OpTypeStruct; });
+    modules.push_back({"result id ~0", words, spvi::reflection_errc::invalid_id, structure});
+    modules.back().words[structure + 1] = 0xFFFFFFFF;
+
+    // An interface ID with a Location which names a type rather than a variable has no storage class to sort it into inputs or outputs
+    auto find_op = [&](spv::Op op_code, auto predicate) { return *std::find_if(offsets.begin(), offsets.end(), [&](uint32_t i) { return static_cast<spv::Op>(words[i] & spv::OpCodeMask) == op_code && predicate(i); }); };
+    const uint32_t located = find_op(spv::Op::OpDecorate, [&](uint32_t i) { return words[i+2] == static_cast<uint32_t>(spv::Decoration::Location); });
+    const uint32_t float_type = find_op(spv::Op::OpTypeFloat, [](uint32_t) { return true; }), entry_point = find_op(spv::Op::OpEntryPoint, [](uint32_t) { return true; });
+    modules.push_back({"not a variable", words, spvi::reflection_errc::invalid_module, float_type});
+    for(uint32_t i=entry_point; i<entry_point + (words[entry_point] >> 16); ++i) if(words[i] == words[located+1]) modules.back().words[i] = words[float_type+1];
+    modules.back().words[located+1] = words[float_type+1];
+
+    auto unbound = remove_instructions(words, [](spv::Op op_code, const uint32_t * first) { return op_code == spv::Op::OpDecorate && first[2] == static_cast<uint32_t>(spv::Decoration::Binding); });
+    modules.push_back({"missing binding", unbound, spvi::reflection_errc::invalid_module, find_variable(unbound)});
+    return modules;
+}
+
+// Checks that the outputs of one stage satisfy the inputs of the next by walking their types, as a baseline for interface signatures.
+// Vector outputs may have more components than the inputs which read them.
+bool compare_interfaces(const std::vector<spvi::variable_info> & outputs, const std::vector<spvi::variable_info> & inputs)
+{
+    for(auto & in : inputs)
+    {
+        auto it = std::find_if(outputs.begin(), outputs.end(), [&](const spvi::variable_info & out) { return out.index == in.index; });
+        if(it == outputs.end()) return false;
+        auto * x = std::get_if<spvi::type::numeric>(&it->type.contents), * y = std::get_if<spvi::type::numeric>(&in.type.contents);
+        if(x && y ? x->elem_kind != y->elem_kind || x->elem_width != y->elem_width || x->column_count != y->column_count || x->row_count < y->row_count : it->type != in.type) return false;
+    }
+    return true;
+}
+
+// Checks that two modules hold the same metadata, comparing every field of every variable, entry point and specialization constant
+bool same_variables(const std::vector<spvi::variable_info> & a, const std::vector<spvi::variable_info> & b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const spvi::variable_info & x, const spvi::variable_info & y)
+    {
+        return x.index == y.index && x.type == y.type && x.name == y.name && x.descriptor_type == y.descriptor_type;
+    });
+}
+
+bool same_modules(const spvi::module_info & a, const spvi::module_info & b)
+{
+    return same_variables(a.push_constants, b.push_constants)
+        && std::equal(a.descriptor_sets.begin(), a.descriptor_sets.end(), b.descriptor_sets.begin(), b.descriptor_sets.end(), [](const spvi::descriptor_set_info & x, const spvi::descriptor_set_info & y)
+        {
+            return x.set == y.set && same_variables(x.descriptors, y.descriptors);
+        })
+        && std::equal(a.entry_points.begin(), a.entry_points.end(), b.entry_points.begin(), b.entry_points.end(), [](const spvi::entry_point_info & x, const spvi::entry_point_info & y)
+        {
+            return x.stage == y.stage && x.name == y.name && same_variables(x.inputs, y.inputs) && same_variables(x.outputs, y.outputs);
+        })
+        && std::equal(a.specialization_constants.begin(), a.specialization_constants.end(), b.specialization_constants.begin(), b.specialization_constants.end(), [](const spvi::specialization_constant_info & x, const spvi::specialization_constant_info & y)
+        {
+            return x.constant_id == y.constant_id && x.name == y.name && x.elem_kind == y.elem_kind && x.elem_width == y.elem_width && x.is_bool == y.is_bool && x.default_value == y.default_value;
+        })
+        && std::equal(a.specialization_program.begin(), a.specialization_program.end(), b.specialization_program.begin(), b.specialization_program.end(), [](const spvi::specialization_op & x, const spvi::specialization_op & y)
+        {
+            return x.op == y.op && x.width == y.width && std::equal(std::begin(x.operands), std::end(x.operands), std::begin(y.operands)) && x.value == y.value;
+        });
+}
+
+template<class F> double measure_seconds(F f)
+{
+    // Run the function repeatedly for at least a tenth of a second, and report the fastest run
+    double best = std::numeric_limits<double>::infinity(), total = 0;
+    for(int runs=0; runs<3 || total<0.1; ++runs)
+    {
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        f();
+        const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    return best;
+}
+
+// Reflects a module repeatedly, reporting the fastest time of each phase of reflection, so that cold first runs do not skew the table,
+// along with the allocations and peak heap use of a single reflection
+void report_phases(const std::string & label, const std::vector<uint32_t> & words)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    double load_us = inf, convert_us = inf, tree_us = inf;
+    int runs = 0;
+    for(auto t0 = std::chrono::steady_clock::now(); runs < 3 || std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(100); ++runs)
+    {
+        spvi::reflection_profile profile;
+        { spvi::module_info info(words, &profile); }
+        uint64_t retained_count = 0;
+        for(auto count : profile.op_code_counts) retained_count += count;
+        if(retained_count != spvi::index_instructions(words).offsets.size()) throw std::logic_error("profile disagrees with index_instructions");
+        load_us = std::min(load_us, profile.load_nanoseconds / 1e3);
+        convert_us = std::min(convert_us, profile.convert_nanoseconds / 1e3);
+        tree_us = std::min(tree_us, profile.tree_nanoseconds / 1e3);
+    }
+    const size_t baseline_bytes = heap::reset();
+    { spvi::module_info info(words); }
+    const size_t allocations = heap::allocation_count, peak_bytes = heap::peak_bytes - baseline_bytes;
+
+    std::cout << std::setw(18) << label << std::setw(10) << words.size() << std::fixed << std::setprecision(1) << std::setw(12) << load_us
+        << std::setw(12) << convert_us << std::setw(12) << tree_us << std::setw(12) << allocations << std::setw(12) << peak_bytes / 1024.0 << std::endl;
+}
+
+int main(int argc, char * argv[]) try
+{
+    // With --cpp, only write a C++ header generated from synthetic modules, which the build compiles in order to check the layouts it asserts
+    if(argc == 3 && strcmp(argv[1], "--cpp") == 0)
+    {
+        module_shape shape;
+        shape.block_count = 4;
+        shape.nesting_depth = 2;
+        shape.specialize_light_count = true;
+        const spvi::module_info uniforms {generate_module(shape)}, resources {generate_resource_module()};
+        std::ofstream out(argv[2]);
+        out << spvi::generate_cpp_header({&uniforms, &resources});
+        if(!out) throw std::runtime_error(std::string("failed to write ") + argv[2]);
+        return EXIT_SUCCESS;
+    }
+
+    std::cout << "Reflection phases over synthetic corpora, scaling one dimension at a time from 64 uniform blocks:" << std::endl;
+    std::cout << std::setw(18) << "corpus" << std::setw(10) << "words" << std::setw(12) << "load (us)" << std::setw(12) << "types (us)" << std::setw(12) << "tree (us)"
+        << std::setw(12) << "allocs" << std::setw(12) << "peak (KB)" << std::endl;
+    module_shape base_shape;
+    base_shape.block_count = 64;
+    for(size_t n : {0, 10000, 100000, 1000000}) { auto shape = base_shape; shape.body_instruction_count = n; report_phases("body ops " + std::to_string(n), generate_module(shape)); }
+    for(size_t n : {8, 32, 128}) { auto shape = base_shape; shape.nesting_depth = n; report_phases("nesting " + std::to_string(n), generate_module(shape)); }
+    for(size_t n : {256, 1024, 4096}) { auto shape = base_shape; shape.block_count = n; report_phases("blocks " + std::to_string(n), generate_module(shape)); }
+    for(size_t n : {16, 256, 1024}) { auto shape = base_shape; shape.entry_point_count = n; report_phases("entry points " + std::to_string(n), generate_module(shape)); }
+
+    std::cout << "\nmodule_info and flat_module_info construction over synthetic uniform modules:" << std::endl;
+    std::cout << std::setw(10) << "blocks" << std::setw(10) << "ids" << std::setw(10) << "words" << std::setw(14) << "time (us)" << std::setw(14) << "ns per id" << std::setw(14) << "flat (us)" << std::setw(14) << "flat ns/id" << std::endl;
+    for(size_t block_count : {256, 512, 1024, 2048, 4096, 8192})
+    {
+        const auto words = generate_uniform_module(block_count);
+        const double seconds = measure_seconds([&]() { spvi::module_info info(words); });
+        const double flat_seconds = measure_seconds([&]() { spvi::flat_module_info info(words); });
+        std::cout << std::setw(10) << block_count << std::setw(10) << words[3] << std::setw(10) << words.size() << std::fixed << std::setprecision(1)
+            << std::setw(14) << seconds*1e6 << std::setw(14) << seconds*1e9/words[3] << std::setw(14) << flat_seconds*1e6 << std::setw(14) << flat_seconds*1e9/words[3] << std::endl;
+    }
+
+    std::cout << "\nInstruction throughput over the declarations of 8192 uniform blocks:" << std::endl;
+    const auto declaration_words = generate_uniform_module(8192);
+    size_t declaration_count = 0;
+    for(size_t i=5; i<declaration_words.size(); i += declaration_words[i] >> 16) ++declaration_count;
+    const double feed_seconds = measure_seconds([&]() { spvi::module_parser parser; parser.feed(declaration_words); });
+    const double parser_seconds = measure_seconds([&]() { spvi::module_parser parser; parser.feed(declaration_words); spvi::flat_module_info info = parser.finish_flat(); });
+    std::cout << "  module_parser::feed:    " << std::setw(8) << std::fixed << std::setprecision(1) << declaration_count / feed_seconds * 1e-6 << " M instructions/s" << std::endl;
+    std::cout << "  module_parser::finish:  " << std::setw(8) << declaration_count / (parser_seconds - feed_seconds) * 1e-6 << " M instructions/s" << std::endl;
+    for(size_t i=0; i<16; ++i)
+    {
+        module_shape shape;
+        shape.block_count = 1 + i*17;
+        shape.body_instruction_count = i % 3 * 1000;
+        shape.nesting_depth = i % 4;
+        shape.entry_point_count = i % 5;
+        shape.specialize_light_count = i % 2 == 1;
+        const auto words = generate_module(shape);
+        if(spvi::index_instructions(words).offsets != find_reflected_instructions(words)) throw std::logic_error("index_instructions disagrees with walking the binary");
+    }
+    const double scan_seconds = measure_seconds([&]() { find_reflected_instructions(declaration_words); });
+    const double index_seconds = measure_seconds([&]() { spvi::index_instructions(declaration_words); });
+    std::cout << "  walking by op code:     " << std::setw(8) << declaration_count / scan_seconds * 1e-6 << " M instructions/s" << std::endl;
+    std::cout << "  index_instructions:     " << std::setw(8) << declaration_count / index_seconds * 1e-6 << " M instructions/s" << std::endl;
+
+    std::cout << "\nmodule_info construction over 256 uniform blocks with function bodies of increasing size:" << std::endl;
+    std::cout << std::setw(10) << "body ops" << std::setw(10) << "words" << std::setw(14) << "time (us)" << std::endl;
+    for(size_t body_instruction_count : {0, 10000, 100000, 1000000})
+    {
+        const auto words = generate_uniform_module(256, body_instruction_count);
+        const double seconds = measure_seconds([&]() { spvi::module_info info(words); });
+        std::cout << std::setw(10) << body_instruction_count << std::setw(10) << words.size() << std::setw(14) << std::fixed << std::setprecision(1) << seconds*1e6 << std::endl;
+    }
+
+    std::cout << "\nmodule_parser over 256 uniform blocks and 100000 body ops, fed in chunks of increasing size:" << std::endl;
+    std::cout << std::setw(10) << "chunk" << std::setw(14) << "time (us)" << std::endl;
+    const auto streamed_words = generate_uniform_module(256, 100000);
+    for(size_t chunk_size : {16, 256, 4096, 65536})
+    {
+        const double seconds = measure_seconds([&]()
+        {
+            spvi::module_parser parser;
+            for(size_t i=0; i<streamed_words.size() && !parser.is_complete(); i+=chunk_size) parser.feed(streamed_words.data() + i, std::min(chunk_size, streamed_words.size() - i));
+            spvi::module_info info = parser.finish();
+        });
+        std::cout << std::setw(10) << chunk_size << std::setw(14) << std::fixed << std::setprecision(1) << seconds*1e6 << std::endl;
+    }
+
+    std::cout << "\nreflect_many over 1024 modules of 64 uniform blocks with varying thread counts:" << std::endl;
+    std::cout << std::setw(10) << "threads" << std::setw(14) << "time (ms)" << std::setw(14) << "speedup" << std::endl;
+    std::vector<std::vector<uint32_t>> corpus;
+    std::vector<spvi::binary_view> binaries;
+    for(size_t i=0; i<1024; ++i)
+    {
+        // Give every module a unique generator word, so that each is a distinct binary as far as the cache is concerned
+        corpus.push_back(generate_uniform_module(64, i % 16 * 1000));
+        corpus.back()[2] = static_cast<uint32_t>(i);
+    }
+    for(auto & words : corpus) binaries.push_back({words.data(), words.size()});
+    double single_thread_seconds = 0;
+    for(size_t thread_count : {1, 2, 4, 8, 16})
+    {
+        if(thread_count > 1 && thread_count > std::thread::hardware_concurrency()) break;
+        const double seconds = measure_seconds([&]() { spvi::reflect_many(binaries, thread_count); });
+        if(thread_count == 1) single_thread_seconds = seconds;
+        std::cout << std::setw(10) << thread_count << std::setw(14) << std::fixed << std::setprecision(2) << seconds*1e3 << std::setw(14) << single_thread_seconds / seconds << std::endl;
+    }
+
+    std::cout << "\nReflection of storage buffers, images, samplers and push constants shared by a vertex and a compute entry point:" << std::endl;
+    const auto resource_words = generate_resource_module();
+    const spvi::module_info resources {resource_words};
+    const double resource_seconds = measure_seconds([&]() { spvi::module_info info(resource_words); });
+    std::cout << "  " << std::fixed << std::setprecision(1) << resource_seconds*1e6 << " us per module" << std::endl;
+    if(resources.descriptor_sets.size() != 1 || resources.descriptor_sets[0].descriptors.size() != 6 || resources.push_constants.size() != 2) throw std::logic_error("wrong resources reflected");
+    const auto & resource_descriptors = resources.descriptor_sets[0].descriptors;
+    const VkDescriptorType resource_types[] {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLER, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER};
+    for(uint32_t i=0; i<6; ++i) if(resource_descriptors[i].index != i || resource_descriptors[i].descriptor_type != resource_types[i]) throw std::logic_error("wrong descriptor type for binding " + std::to_string(i));
+    {
+        auto & particle_buffer = std::get<spvi::type::structure>(resource_descriptors[0].type.contents);
+        auto & particles = std::get<spvi::type::array>(static_cast<const spvi::type &>(particle_buffer.members[1].member_type).contents);
+        if(particle_buffer.size != 16 || particles.elem_count != 0 || particles.stride != 32u || std::get<spvi::type::structure>(static_cast<const spvi::type &>(particles.elem_type).contents).size != 32) throw std::logic_error("wrong layout of runtime array of particles");
+        auto & storage_image = std::get<spvi::type::image>(resource_descriptors[1].type.contents);
+        if(!storage_image.is_storage || storage_image.format != VK_FORMAT_R32G32B32A32_SFLOAT || std::get<spvi::type::image>(resource_descriptors[2].type.contents).is_storage) throw std::logic_error("wrong storage image");
+        if(!std::holds_alternative<spvi::type::separate_sampler>(resource_descriptors[3].type.contents)) throw std::logic_error("wrong separate sampler");
+        if(std::get<spvi::type::array>(resource_descriptors[4].type.contents).elem_count != 0) throw std::logic_error("wrong runtime array of images");
+        auto & weight_buffer = std::get<spvi::type::structure>(resource_descriptors[5].type.contents);
+        if(weight_buffer.size != 0 || std::get<spvi::type::array>(static_cast<const spvi::type &>(weight_buffer.members[0].member_type).contents).elem_count != 0) throw std::logic_error("wrong runtime array of floats");
+
+        auto & transform = std::get<spvi::type::structure>(resources.push_constants[0].type.contents);
+        auto & matrix = std::get<spvi::type::numeric>(static_cast<const spvi::type &>(transform.members[1].member_type).contents);
+        if(!spvi::is_row_major(matrix) || matrix.row_stride != 16 || transform.members[1].size != 64 || transform.size != 80) throw std::logic_error("wrong layout of row-major matrix");
+        if(std::get<spvi::type::structure>(resources.push_constants[1].type.contents).size != 100) throw std::logic_error("wrong size of push constant block");
+
+        // Both stages share every descriptor, and a single push constant range which spans both blocks
+        const auto merged = spvi::merge_pipeline_layout({&resources});
+        const VkShaderStageFlags both_stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+        if(merged.set_layouts.size() != 1 || merged.set_layouts[0].bindings.size() != 6) throw std::logic_error("wrong merged resource layout");
+        for(auto & b : merged.set_layouts[0].bindings) if(b.stageFlags != both_stages || b.descriptorCount != (b.binding == 4 ? 0u : 1u)) throw std::logic_error("wrong merged binding " + std::to_string(b.binding));
+        if(merged.push_constant_ranges.size() != 1 || merged.push_constant_ranges[0].stageFlags != both_stages || merged.push_constant_ranges[0].offset != 0 || merged.push_constant_ranges[0].size != 100) throw std::logic_error("wrong merged push constant ranges");
+    }
+
+    std::cout << "\npipeline_layout_cache over 4096 pipelines built from 64 vertex and 64 fragment modules:" << std::endl;
+    std::vector<spvi::module_info> stage_modules;
+    for(size_t i=0; i<128; ++i)
+    {
+        stage_modules.push_back(spvi::module_info{generate_uniform_module(4 + i % 8)});
+        stage_modules.back().entry_points = {{i < 64 ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT, {}, {}, "main"}};
+    }
+    size_t created_set_layouts = 0, created_pipeline_layouts = 0;
+    const double layout_seconds = measure_seconds([&]()
+    {
+        created_set_layouts = created_pipeline_layouts = 0;
+        spvi::pipeline_layout_cache layouts {
+            [&](const VkDescriptorSetLayoutCreateInfo &) { return VkDescriptorSetLayout(++created_set_layouts); },
+            [&](const VkPipelineLayoutCreateInfo &) { return VkPipelineLayout(++created_pipeline_layouts); }};
+        for(size_t i=0; i<4096; ++i) layouts.get_pipeline_layout({&stage_modules[i % 64], &stage_modules[64 + i / 64]});
+    });
+    std::cout << "  " << std::fixed << std::setprecision(2) << layout_seconds*1e3 << " ms, " << layout_seconds*1e9/4096 << " ns per pipeline, creating "
+        << created_set_layouts << " set layouts and " << created_pipeline_layouts << " pipeline layouts" << std::endl;
+
+    // Vertex module 0 has blocks 0 to 3 and fragment module 7 has blocks 0 to 10, where block k is at set k % 4 and binding k / 4
+    const auto merged_layout = spvi::merge_pipeline_layout({&stage_modules[0], &stage_modules[64 + 7]});
+    if(merged_layout.set_layouts.size() != 4 || !merged_layout.push_constant_ranges.empty()) throw std::logic_error("wrong number of merged set layouts");
+    size_t merged_binding_count = 0;
+    for(uint32_t set=0; set<4; ++set)
+    {
+        for(auto & b : merged_layout.set_layouts[set].bindings)
+        {
+            const VkShaderStageFlags expected_stages = b.binding * 4 + set < 4 ? VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+            if(b.binding != static_cast<uint32_t>(&b - merged_layout.set_layouts[set].bindings.data()) || b.stageFlags != expected_stages) throw std::logic_error("wrong merged stage flags");
+            if(b.descriptorType != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || b.descriptorCount != 1) throw std::logic_error("wrong merged descriptor count");
+            ++merged_binding_count;
+        }
+    }
+    if(merged_binding_count != 11) throw std::logic_error("wrong number of merged bindings");
+
+    // Modules 8 and 72 have the same blocks as modules 0 and 64, so their layouts are equal and hash equally, while module 65 has one more block
+    const auto equal_layout = spvi::merge_pipeline_layout({&stage_modules[8], &stage_modules[72]}), base_layout = spvi::merge_pipeline_layout({&stage_modules[0], &stage_modules[64]});
+    if(equal_layout != base_layout || spvi::hash_layout(equal_layout) != spvi::hash_layout(base_layout) || spvi::hash_layout(equal_layout.set_layouts[1]) != spvi::hash_layout(base_layout.set_layouts[1])) throw std::logic_error("equal layouts are not equal");
+    if(spvi::merge_pipeline_layout({&stage_modules[0], &stage_modules[65]}) == base_layout) throw std::logic_error("different layouts are equal");
+
+    // Pipelines differ only in how many blocks each stage has, giving 8 x 8 pipeline layouts, which share 9 distinct set layouts
+    if(created_set_layouts != 9 || created_pipeline_layouts != 64) throw std::logic_error("pipeline_layout_cache created the wrong number of layouts");
+
+    std::cout << "\nspecialize over 256 uniform blocks whose light arrays are sized by a specialization constant:" << std::endl;
+    const auto specializable_words = generate_uniform_module(256, 0, true);
+    const spvi::module_info specializable {specializable_words};
+    const spvi::flat_module_info flat_specializable {specializable_words};
+    for(uint32_t max_lights : {3, 7, 15})
+    {
+        const spvi::specialization_value value {0, max_lights};
+        const auto & block = std::get<spvi::type::structure>(spvi::specialize(specializable, &value, 1).descriptor_sets[0].descriptors[0].type.contents);
+        if(block.size != 96 + (max_lights + 1) * 32) throw std::logic_error("wrong specialized block size");
+
+        // Interning the specialized tree again merges any types which specialization made identical, which the flat overload must not have duplicated
+        if(spvi::specialize(flat_specializable, &value, 1).types.types.size() != spvi::flat_module_info{spvi::specialize(specializable, &value, 1)}.types.types.size()) throw std::logic_error("specialized type graph holds duplicate types");
+    }
+    uint32_t variant = 0;
+    const double specialize_seconds = measure_seconds([&]() { const spvi::specialization_value value {0, ++variant % 64}; spvi::specialize(specializable, &value, 1); });
+    const double flat_specialize_seconds = measure_seconds([&]() { const spvi::specialization_value value {0, ++variant % 64}; spvi::specialize(flat_specializable, &value, 1); });
+    const double reflect_seconds = measure_seconds([&]() { spvi::module_info info {specializable_words}; });
+    std::cout << "  module_info:      " << std::setw(10) << std::fixed << std::setprecision(1) << specialize_seconds*1e6 << " us per variant" << std::endl;
+    std::cout << "  flat_module_info: " << std::setw(10) << flat_specialize_seconds*1e6 << " us per variant" << std::endl;
+    std::cout << "  reflecting again: " << std::setw(10) << reflect_seconds*1e6 << " us per variant" << std::endl;
+
+    std::cout << "\nUniform field lookups by name within a block of 4 lights:" << std::endl;
+    const spvi::module_info material {generate_uniform_module(1)};
+    const spvi::type & material_block = material.descriptor_sets[0].descriptors[0].type;
+    const spvi::block_map material_map {material_block};
+    const char * const field_paths[] {"transform", "tint", "intensity", "lights[0].position", "lights[1].color", "lights[2].position", "lights[3].color"};
+    for(auto * path : field_paths)
+    {
+        const auto location = material_map.locate(path);
+        if(!location || location.offset != find_field_offset(material_block, path)) throw std::logic_error("block_map disagrees with the block");
+    }
+    constexpr uint64_t light_color = spvi::block_map::hash_path("lights[].color");
+    const size_t lookup_count = 1 << 20;
+    size_t offset_sum = 0;
+    const double walk_seconds = measure_seconds([&]() { for(size_t i=0; i<lookup_count; ++i) offset_sum += *find_field_offset(material_block, field_paths[i % 7]); });
+    const double path_seconds = measure_seconds([&]() { for(size_t i=0; i<lookup_count; ++i) offset_sum += material_map.locate(field_paths[i % 7]).offset; });
+    const double token_seconds = measure_seconds([&]() { for(size_t i=0; i<lookup_count; ++i) offset_sum += material_map.locate(light_color, {i % 4}).offset; });
+    std::cout << "  walking members:     " << std::setw(8) << std::fixed << std::setprecision(1) << lookup_count / walk_seconds * 1e-6 << " M lookups/s" << std::endl;
+    std::cout << "  block_map by path:   " << std::setw(8) << lookup_count / path_seconds * 1e-6 << " M lookups/s" << std::endl;
+    std::cout << "  block_map by token:  " << std::setw(8) << lookup_count / token_seconds * 1e-6 << " M lookups/s" << std::endl;
+    if(offset_sum == 0) throw std::logic_error("no fields were found");
+
+    std::cout << "\nInterface compatibility of 1024 vertex shaders with 1024 fragment shaders:" << std::endl;
+    std::vector<spvi::entry_point_info> vertex_stages, fragment_stages;
+    for(uint32_t i=0; i<1024; ++i)
+    {
+        vertex_stages.push_back({VK_SHADER_STAGE_VERTEX_BIT, {}, generate_interface(i % 64 * 0x9E3779B9 | 0xAAAA, 8), "main"});
+        fragment_stages.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, generate_interface(i % 61 * 0x9E3779B9 | 0xAAAA, 4 + i % 5), {}, "main"});
+    }
+    std::vector<spvi::interface_signature> vertex_signatures, fragment_signatures;
+    const double signature_seconds = measure_seconds([&]()
+    {
+        vertex_signatures.clear();
+        fragment_signatures.clear();
+        for(auto & e : vertex_stages) vertex_signatures.push_back(spvi::get_output_signature(e));
+        for(auto & e : fragment_stages) fragment_signatures.push_back(spvi::get_input_signature(e));
+    });
+    size_t compatible_count = 0;
+    const double tree_seconds = measure_seconds([&]()
+    {
+        compatible_count = 0;
+        for(auto & v : vertex_stages) for(auto & f : fragment_stages) compatible_count += compare_interfaces(v.outputs, f.inputs);
+    });
+    const size_t expected_count = compatible_count;
+    const double pairwise_seconds = measure_seconds([&]()
+    {
+        compatible_count = 0;
+        for(auto & v : vertex_signatures) for(auto & f : fragment_signatures) compatible_count += spvi::is_interface_compatible(v, f);
+    });
+    if(compatible_count != expected_count) throw std::logic_error("interface signatures disagree with the types they were built from");
+    std::vector<uint8_t> compatibility;
+    const double batch_seconds = measure_seconds([&]() { compatibility = spvi::check_interface_compatibility(vertex_signatures, fragment_signatures); });
+    if(static_cast<size_t>(std::count(compatibility.begin(), compatibility.end(), 1)) != expected_count) throw std::logic_error("batch compatibility disagrees with pairwise compatibility");
+    std::cout << "  building signatures: " << std::setw(10) << std::fixed << std::setprecision(2) << signature_seconds*1e3 << " ms" << std::endl;
+    std::cout << "  walking types:       " << std::setw(10) << tree_seconds*1e3 << " ms, " << tree_seconds*1e9/(1 << 20) << " ns per pair" << std::endl;
+    std::cout << "  signature pairs:     " << std::setw(10) << pairwise_seconds*1e3 << " ms, " << pairwise_seconds*1e9/(1 << 20) << " ns per pair" << std::endl;
+    std::cout << "  batch check:         " << std::setw(10) << batch_seconds*1e3 << " ms, " << batch_seconds*1e9/(1 << 20) << " ns per pair, " << expected_count << " compatible pairs" << std::endl;
+
+    std::cout << "\nget_vertex_input_layout over a vertex shader with 7 inputs of mixed widths and storage, one of them a matrix:" << std::endl;
+    auto vertex_input = [](uint32_t location, spvi::type::number_kind kind, size_t width, size_t row_count, size_t column_count = 1) -> spvi::variable_info
+    {
+        return {location, spvi::type{spvi::type::numeric{kind, width, row_count, column_count, width/8, 0}}, "in" + std::to_string(location)};
+    };
+    const spvi::entry_point_info vertex_inputs {VK_SHADER_STAGE_VERTEX_BIT, {vertex_input(0, spvi::type::float_, 32, 3), vertex_input(1, spvi::type::float_, 32, 4, 4),
+        vertex_input(5, spvi::type::float_, 32, 2), vertex_input(6, spvi::type::uint_, 32, 4), vertex_input(7, spvi::type::float_, 32, 3), vertex_input(8, spvi::type::float_, 64, 2),
+        vertex_input(9, spvi::type::int_, 32, 3)}, {}, "main"};
+    const std::vector<spvi::vertex_attribute_storage> vertex_storages {{5, spvi::vertex_storage::unorm16}, {6, spvi::vertex_storage::int8}, {7, spvi::vertex_storage::unorm8}, {9, spvi::vertex_storage::int16}};
+    spvi::vertex_input_layout vertex_layout;
+    const double vertex_layout_seconds = measure_seconds([&]() { vertex_layout = spvi::get_vertex_input_layout(vertex_inputs, vertex_storages); });
+    std::cout << "  " << std::fixed << std::setprecision(2) << vertex_layout_seconds*1e6 << " us per layout, with a stride of " << vertex_layout.bindings[0].stride << " bytes" << std::endl;
+
+    // Attributes with the largest components come first, so that the stride is the sum of the attribute sizes, with the three component
+    // 8 and 16-bit attributes padded to four components, and the mat4 at location 1 is expanded into one attribute per column
+    const VkVertexInputAttributeDescription expected_attributes[] {
+        {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 16}, {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 28}, {2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 44}, {3, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 60},
+        {4, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 76}, {5, 0, VK_FORMAT_R16G16_UNORM, 92}, {6, 0, VK_FORMAT_R8G8B8A8_UINT, 104}, {7, 0, VK_FORMAT_R8G8B8A8_UNORM, 108},
+        {8, 0, VK_FORMAT_R64G64_SFLOAT, 0}, {9, 0, VK_FORMAT_R16G16B16A16_SINT, 96}};
+    if(vertex_layout.bindings.size() != 1 || vertex_layout.bindings[0].stride != 112 || vertex_layout.attributes.size() != std::size(expected_attributes)) throw std::logic_error("wrong interleaved vertex binding");
+    for(size_t i=0; i<std::size(expected_attributes); ++i)
+    {
+        const auto & a = vertex_layout.attributes[i], & e = expected_attributes[i];
+        if(std::tie(a.location, a.binding, a.format, a.offset) != std::tie(e.location, e.binding, e.format, e.offset)) throw std::logic_error("wrong vertex attribute at location " + std::to_string(e.location));
+    }
+    const auto separate_layout = spvi::get_vertex_input_layout(vertex_inputs, vertex_storages, false);
+    if(separate_layout.bindings.size() != std::size(expected_attributes)) throw std::logic_error("wrong number of separate vertex bindings");
+    for(uint32_t i=0; i<separate_layout.bindings.size(); ++i)
+    {
+        auto & a = separate_layout.attributes[i];
+        if(a.binding != i || a.offset != 0 || a.format != expected_attributes[i].format || separate_layout.bindings[i].stride != spvi::get_vertex_format_size(a.format)) throw std::logic_error("wrong separate vertex binding " + std::to_string(i));
+    }
+
+    // Normalized storage cannot supply integer inputs, and 64-bit inputs can only be read from 64-bit formats
+    const spvi::type::numeric dvec3 {spvi::type::float_, 64, 3, 1, 8, 0}, ivec2 {spvi::type::int_, 32, 2, 1, 4, 0};
+    if(spvi::get_vertex_format(dvec3) != VK_FORMAT_R64G64B64_SFLOAT) throw std::logic_error("wrong 64-bit vertex format");
+    for(auto [input, storage] : {std::make_pair(dvec3, spvi::vertex_storage::unorm8), std::make_pair(dvec3, spvi::vertex_storage::float16), std::make_pair(ivec2, spvi::vertex_storage::snorm16)})
+    {
+        bool rejected = false;
+        try { spvi::get_vertex_format(input, storage); } catch(const std::logic_error &) { rejected = true; }
+        if(!rejected) throw std::logic_error("vertex storage was accepted for an input it cannot supply");
+    }
+
+    std::cout << "\nReflection of stripped and malformed modules of 16 uniform blocks and an entry point, per module:" << std::endl;
+    std::cout << std::setw(18) << "corpus" << std::setw(18) << "throwing (us)" << std::setw(18) << "try_reflect (us)" << std::endl;
+    module_shape rejection_shape;
+    rejection_shape.block_count = 16;
+    rejection_shape.entry_point_count = 1;
+    const auto named_words = generate_module(rejection_shape), stripped_words = strip_names(named_words);
+    const spvi::module_info named {named_words}, stripped {stripped_words};
+    const auto stripped_result = spvi::try_reflect(stripped_words);
+    if(!stripped_result || stripped_result->descriptor_sets.size() != named.descriptor_sets.size() || stripped.descriptor_sets.size() != named.descriptor_sets.size()) throw std::logic_error("stripped module was not reflected");
+    if(!stripped.descriptor_sets[0].descriptors[0].name.empty() || stripped.descriptor_sets[0].descriptors[0].type != stripped_result->descriptor_sets[0].descriptors[0].type) throw std::logic_error("stripped module has names");
+    auto report_rejection = [&](const char * label, const std::vector<uint32_t> & words)
+    {
+        // Each measurement reflects the module 1000 times, so milliseconds per measurement are microseconds per module
+        const double throwing_seconds = measure_seconds([&]() { for(int i=0; i<1000; ++i) { try { spvi::module_info info(words); } catch(const std::exception &) {} } });
+        const double expected_seconds = measure_seconds([&]() { for(int i=0; i<1000; ++i) spvi::try_reflect(words); });
+        std::cout << std::setw(18) << label << std::fixed << std::setprecision(2) << std::setw(18) << throwing_seconds*1e3 << std::setw(18) << expected_seconds*1e3 << std::endl;
+    };
+    report_rejection("stripped", stripped_words);
+    for(auto & m : generate_malformed_modules(named_words))
+    {
+        const auto result = spvi::try_reflect(m.words);
+        if(result || result.error().code != m.code || result.error().word_offset != m.word_offset) throw std::logic_error(std::string("try_reflect misreported a module which is ") + m.label);
+        bool rejected = false;
+        try { spvi::module_info info(m.words); }
+        catch(const std::exception & e) { rejected = strcmp(e.what(), result.error().message) == 0; }
+        if(!rejected) throw std::logic_error(std::string("module_info and try_reflect disagree about a module which is ") + m.label);
+        report_rejection(m.label, m.words);
+    }
+
+    std::cout << "\nArchives of synthetic modules, as stored by reflection_cache, compared with reflecting, per module:" << std::endl;
+    std::cout << std::setw(18) << "corpus" << std::setw(10) << "bytes" << std::setw(14) << "reflect (us)" << std::setw(14) << "view (us)" << std::setw(14) << "tree (us)" << std::endl;
+    auto report_archive = [&](const std::string & label, const module_shape & shape)
+    {
+        const auto words = generate_module(shape);
+        const spvi::module_info info {words};
+        const auto archive = spvi::write_archive(info);
+        if(!same_modules(spvi::archive_view{archive.data(), archive.size()}.get_module_info(), info)) throw std::logic_error("archive did not round trip");
+        if(spvi::write_archive(spvi::archive_view{archive.data(), archive.size()}.get_flat_module_info()) != archive) throw std::logic_error("archive was not rewritten identically");
+
+        // A truncated archive, or one whose references point forwards, must be rejected rather than read out of bounds
+        bool rejected = false;
+        try { spvi::archive_view view {archive.data(), archive.size() - 8}; } catch(const std::runtime_error &) { rejected = true; }
+        if(!rejected) throw std::logic_error("truncated archive was accepted");
+        auto corrupted = archive;
+        const auto & header = *reinterpret_cast<const spvi::archive_header *>(corrupted.data());
+        auto & section = header.sections[static_cast<size_t>(spvi::archive_section::members)];
+        if(section.count)
+        {
+            reinterpret_cast<spvi::archived_member *>(corrupted.data() + section.offset)->type = spvi::archive_none - 1;
+            rejected = false;
+            try { spvi::archive_view view {corrupted.data(), corrupted.size()}; } catch(const std::runtime_error &) { rejected = true; }
+            if(!rejected) throw std::logic_error("corrupted archive was accepted");
+        }
+        if(!info.specialization_program.empty())
+        {
+            // Likewise an archive whose array lengths refer past the end of its specialization program
+            auto unprogrammed = info;
+            unprogrammed.specialization_program.clear();
+            const auto bad_archive = spvi::write_archive(unprogrammed);
+            rejected = false;
+            try { spvi::archive_view view {bad_archive.data(), bad_archive.size()}; } catch(const std::runtime_error &) { rejected = true; }
+            if(!rejected) throw std::logic_error("archive with a bad specialization expression was accepted");
+        }
+
+        const double reflect_seconds = measure_seconds([&]() { spvi::module_info info {words}; });
+        const double view_seconds = measure_seconds([&]() { spvi::archive_view view {archive.data(), archive.size()}; });
+        const double tree_seconds = measure_seconds([&]() { spvi::archive_view{archive.data(), archive.size()}.get_module_info(); });
+        std::cout << std::setw(18) << label << std::setw(10) << archive.size() << std::fixed << std::setprecision(2) << std::setw(14) << reflect_seconds*1e6
+            << std::setw(14) << view_seconds*1e6 << std::setw(14) << tree_seconds*1e6 << std::endl;
+    };
+    for(size_t n : {16, 256, 4096}) { module_shape shape; shape.block_count = n; report_archive("blocks " + std::to_string(n), shape); }
+    { module_shape shape; shape.block_count = 64; shape.nesting_depth = 32; report_archive("nesting 32", shape); }
+    { module_shape shape; shape.block_count = 64; shape.entry_point_count = 256; report_archive("entry points 256", shape); }
+    { module_shape shape; shape.block_count = 64; shape.specialize_light_count = true; report_archive("specialized", shape); }
+    { module_shape shape; report_archive("empty", shape); }
+
+    std::cout << "\nstrip_module over synthetic modules of 64 uniform blocks, per module:" << std::endl;
+    std::cout << std::setw(18) << "corpus" << std::setw(10) << "words" << std::setw(10) << "stripped" << std::setw(14) << "strip (us)" << std::setw(14) << "reflect (us)" << std::setw(16) << "stripped (us)" << std::endl;
+    auto report_stripping = [&](const std::string & label, module_shape shape)
+    {
+        shape.block_count = 64;
+        const auto words = generate_module(shape);
+        const auto stripped = spvi::strip_module(words);
+        if(!same_modules(stripped.info, spvi::module_info{words})) throw std::logic_error("strip_module reflected the wrong interface");
+        if(stripped.words.size() >= words.size() || find_reflected_instructions(stripped.words).size() >= find_reflected_instructions(words).size()) throw std::logic_error("strip_module removed nothing");
+        if(spvi::strip_module(stripped.words).words != stripped.words) throw std::logic_error("strip_module is not idempotent");
+
+        const double strip_seconds = measure_seconds([&]() { spvi::strip_module(words); });
+        const double reflect_seconds = measure_seconds([&]() { spvi::module_info info {words}; });
+        const double stripped_seconds = measure_seconds([&]() { spvi::module_info info {stripped.words}; });
+        std::cout << std::setw(18) << label << std::setw(10) << words.size() << std::setw(10) << stripped.words.size() << std::fixed << std::setprecision(1)
+            << std::setw(14) << strip_seconds*1e6 << std::setw(14) << reflect_seconds*1e6 << std::setw(16) << stripped_seconds*1e6 << std::endl;
+    };
+    { module_shape shape; report_stripping("names only", shape); }
+    { module_shape shape; shape.debug_info = true; shape.body_instruction_count = 10000; report_stripping("debug info", shape); }
+    { module_shape shape; shape.unused_block_count = 256; report_stripping("unused blocks 256", shape); }
+    { module_shape shape; shape.nesting_depth = 32; shape.specialize_light_count = true; report_stripping("specialized", shape); }
+    { module_shape shape; shape.entry_point_count = 256; report_stripping("entry points 256", shape); }
+
+    std::cout << "\nResident memory of 5000 shader permutations, reflected separately and into a module_family:" << std::endl;
+    auto measure_resident = [&](auto & results, auto reflect)
+    {
+        // Each permutation is generated and freed in turn, so that only the reflected results remain live
+        const size_t live_bytes = heap::live_bytes;
+        for(uint32_t p=0; p<5000; ++p) reflect(results, generate_permutation(p));
+        return (heap::live_bytes - live_bytes) / (1024.0 * 1024.0);
+    };
+    std::vector<spvi::module_info> permutation_infos;
+    std::vector<spvi::flat_module_info> permutation_flat_infos;
+    spvi::module_family family;
+    const double tree_megabytes = measure_resident(permutation_infos, [](auto & infos, const std::vector<uint32_t> & words) { infos.emplace_back(words); });
+    const double flat_megabytes = measure_resident(permutation_flat_infos, [](auto & infos, const std::vector<uint32_t> & words) { infos.emplace_back(words); });
+    const double family_megabytes = measure_resident(family, [](spvi::module_family & f, const std::vector<uint32_t> & words) { f.add_module(words); });
+    for(size_t i=0; i<family.get_module_count(); i += 97) if(!same_modules(family.get_module_info(i), permutation_infos[i])) throw std::logic_error("module_family disagrees with module_info");
+    const auto usage = family.get_memory_usage();
+    if(usage.shared_bytes >= usage.unshared_bytes) throw std::logic_error("module_family shared nothing");
+    std::cout << "  module_info:      " << std::setw(10) << std::fixed << std::setprecision(2) << tree_megabytes << " MB" << std::endl;
+    std::cout << "  flat_module_info: " << std::setw(10) << flat_megabytes << " MB" << std::endl;
+    std::cout << "  module_family:    " << std::setw(10) << family_megabytes << " MB, holding " << family.get_types().types.size() << " shared types in "
+        << usage.shared_bytes / 1024.0 << " KB, and " << usage.get_deduplicated_bytes() / (1024.0 * 1024.0) << " MB less type graph than separate modules" << std::endl;
+
+    std::cout << "\nreflection_cache over the same 1024 modules:" << std::endl;
+    const auto cache_directory = std::filesystem::temp_directory_path() / "spvi-benchmark-cache";
+    std::filesystem::remove_all(cache_directory);
+    spvi::reflection_cache cache(cache_directory.string());
+    auto time_corpus = [&](auto reflect)
+    {
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for(auto & words : corpus) reflect(words);
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+    };
+    const double uncached_seconds = time_corpus([&](const std::vector<uint32_t> & words) { spvi::module_info info(words); });
+    const double cold_seconds = time_corpus([&](const std::vector<uint32_t> & words) { cache.reflect(words); });
+    const double warm_seconds = time_corpus([&](const std::vector<uint32_t> & words) { cache.reflect(words); });
+    std::cout << "  uncached:   " << std::setw(10) << std::fixed << std::setprecision(2) << uncached_seconds*1e3 << " ms" << std::endl;
+    std::cout << "  cold cache: " << std::setw(10) << cold_seconds*1e3 << " ms" << std::endl;
+    std::cout << "  warm cache: " << std::setw(10) << warm_seconds*1e3 << " ms (" << uncached_seconds / warm_seconds << "x faster than uncached)" << std::endl;
+
+    // Entries are only an optimization, so a cache which can no longer write to its directory must still reflect every module
+    std::filesystem::remove_all(cache_directory);
+    if(!same_modules(cache.reflect(corpus[0]), spvi::module_info{corpus[0]}) || cache.load(corpus[0].data(), corpus[0].size())) throw std::logic_error("reflection_cache failed when its entry could not be stored");
+    return EXIT_SUCCESS;
+}
+catch (const std::exception & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,15 @@
+// Includes the header which the benchmark generates from its synthetic modules with --cpp, so that the static_asserts which generate_cpp_header
+// writes on every offset and size are checked by a C++ compiler, along with the declarations which those asserts cannot tell apart
+#include "generated-blocks.h"
+#include <type_traits>
+
+// The row-major matrix of the first push constant block has three columns of four rows, and is declared as its four rows, each padded to 16 bytes
+static_assert(std::is_same_v<decltype(transform_constants::transform), float[4][4]>);
+static_assert(offsetof(transform_constants, transform) == 16 && sizeof(transform_constants) == 80);
+
+// Column-major matrices are declared as their columns
+static_assert(std::is_same_v<decltype(block0::transform), float[4][4]>);
+
+// Runtime arrays are not part of the structs of storage buffers
+static_assert(sizeof(particle_buffer) == 16 && sizeof(particle) == 32);
+static_assert(std::is_empty_v<weight_buffer>);
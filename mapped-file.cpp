@@ -0,0 +1,79 @@
+#include "mapped-file.h"
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+spvi::mapped_file::mapped_file(const char * path)
+{
+#ifdef _WIN32
+    file_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file_handle == INVALID_HANDLE_VALUE) { file_handle = nullptr; throw std::runtime_error(std::string("unable to open ") + path); }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file_handle, &file_size)) { unmap(); throw std::runtime_error(std::string("unable to query size of ") + path); }
+    length = static_cast<size_t>(file_size.QuadPart);
+    if(length == 0) return; // Empty files cannot be mapped, but are trivially represented by a null range
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping_handle) { unmap(); throw std::runtime_error(std::string("unable to map ") + path); }
+    address = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if(!address) { unmap(); throw std::runtime_error(std::string("unable to map ") + path); }
+#else
+    const int fd = open(path, O_RDONLY);
+    if(fd < 0) throw std::runtime_error(std::string("unable to open ") + path);
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) { close(fd); throw std::runtime_error(std::string("unable to query size of ") + path); }
+    if(!S_ISREG(st.st_mode)) { close(fd); throw std::runtime_error(std::string("not a regular file: ") + path); }
+    length = static_cast<size_t>(st.st_size);
+    if(length == 0) { close(fd); return; } // Empty files cannot be mapped, but are trivially represented by a null range
+
+    void * mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps its own reference to the file
+    if(mapping == MAP_FAILED) { length = 0; throw std::runtime_error(std::string("unable to map ") + path); }
+    address = mapping;
+#endif
+}
+
+spvi::mapped_file::mapped_file(mapped_file && r)
+{
+    *this = std::move(r);
+}
+
+spvi::mapped_file & spvi::mapped_file::operator = (mapped_file && r)
+{
+    if(this == &r) return *this;
+    unmap();
+    std::swap(address, r.address);
+    std::swap(length, r.length);
+#ifdef _WIN32
+    std::swap(file_handle, r.file_handle);
+    std::swap(mapping_handle, r.mapping_handle);
+#endif
+    return *this;
+}
+
+void spvi::mapped_file::unmap()
+{
+#ifdef _WIN32
+    if(address) UnmapViewOfFile(address);
+    if(mapping_handle) CloseHandle(mapping_handle);
+    if(file_handle) CloseHandle(file_handle);
+    file_handle = mapping_handle = nullptr;
+#else
+    if(address) munmap(const_cast<void *>(address), length);
+#endif
+    address = nullptr;
+    length = 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace spvi
+{
+    // Read-only memory mapping of the entire contents of a file, which is unmapped when the object is destroyed
+    class mapped_file
+    {
+        const void * address = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        void * file_handle = nullptr, * mapping_handle = nullptr;
+#endif
+        void unmap();
+    public:
+        mapped_file() = default;
+        explicit mapped_file(const char * path); // Throws std::runtime_error if the file cannot be opened or mapped
+        mapped_file(mapped_file && r);
+        mapped_file(const mapped_file & r) = delete;
+        ~mapped_file() { unmap(); }
+
+        mapped_file & operator = (mapped_file && r);
+        mapped_file & operator = (const mapped_file & r) = delete;
+
+        const void * data() const { return address; }
+        size_t size() const { return length; }
+
+        // Mappings are page aligned, so the contents of a SPIR-V binary can be accessed in place
+        const uint32_t * words() const { return reinterpret_cast<const uint32_t *>(address); }
+        size_t word_count() const { return length / sizeof(uint32_t); }
+    };
+}
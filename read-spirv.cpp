@@ -1,18 +1,13 @@
 #include "spirv-interface.h"
+#include "spirv-codegen.h"
+#include "mapped-file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
 
-std::vector<uint32_t> load_spirv_binary(const char * path)
-{
-    FILE * f = fopen(path, "rb");
-    fseek(f, 0, SEEK_END);
-    auto len = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    std::vector<uint32_t> words(len/4);
-    fread(words.data(), sizeof(uint32_t), words.size(), f);
-    fclose(f);
-    return words;
-}
-
 template<class T> struct indented { const T & value; int indent; };
 
 std::ostream & operator << (std::ostream & out, indented<spvi::type> t);
@@ -28,6 +23,7 @@ std::ostream & operator << (std::ostream & out, indented<spvi::type::numeric> t)
         throw std::logic_error("unsupported type");
     }
 
+    if(spvi::is_row_major(t.value)) out << "row_major ";
     if(t.value.elem_kind == spvi::type::float_ && t.value.elem_width == 32) out << "";
     else if(t.value.elem_kind == spvi::type::float_ && t.value.elem_width == 64) out << "d";
     else if(t.value.elem_kind == spvi::type::int_ && t.value.elem_width == 32) out << "i";
@@ -41,14 +37,19 @@ std::ostream & operator << (std::ostream & out, indented<spvi::type::numeric> t)
 
 std::ostream & operator << (std::ostream & out, indented<spvi::type::array> t)
 {
-    out << indented<spvi::type>{t.value.elem_type,t.indent} << '[' << t.value.elem_count << ']';
+    out << indented<spvi::type>{t.value.elem_type,t.indent} << '[';
+    if(t.value.elem_count) out << t.value.elem_count;
+    if(t.value.elem_count_expression) out << " /*specialized*/";
+    out << ']';
     if(t.value.stride) out << " /*stride=" << *t.value.stride << "*/";
     return out;
 }
 
 std::ostream & operator << (std::ostream & out, indented<spvi::type::structure> t)
 {
-    out << "struct " << t.value.name << "\n" << std::string(t.indent,' ') << "{\n";
+    out << "struct " << t.value.name;
+    if(t.value.size) out << " /*size=" << t.value.size << "*/";
+    out << "\n" << std::string(t.indent,' ') << "{\n";
     for(auto & m : t.value.members) 
     {
         out << std::string(t.indent+2,' ');
@@ -58,70 +59,234 @@ std::ostream & operator << (std::ostream & out, indented<spvi::type::structure>
     return out << std::string(t.indent,' ') << "}";
 }
 
-std::ostream & operator << (std::ostream & out, indented<spvi::type::sampler> t)
+// Prints the GLSL name of an opaque type, such as isampler2DArray or image2DMS
+std::ostream & print_opaque_type(std::ostream & out, const char * prefix, spvi::type::number_kind channel_kind, VkImageViewType view_type, bool is_multisampled, bool is_shadow)
 {
-    switch(t.value.channel_kind)
+    switch(channel_kind)
     {
     case spvi::type::int_: out << 'i'; break;
     case spvi::type::uint_: out << 'u'; break;
+    default: break;
     }
-    switch(t.value.view_type)
+    out << prefix;
+    switch(view_type)
     {
-    case VK_IMAGE_VIEW_TYPE_1D: case VK_IMAGE_VIEW_TYPE_1D_ARRAY: out << "sampler1D"; break;
-    case VK_IMAGE_VIEW_TYPE_2D: case VK_IMAGE_VIEW_TYPE_2D_ARRAY: out << "sampler2D"; break;
-    case VK_IMAGE_VIEW_TYPE_3D: out << "sampler3D"; break;
-    case VK_IMAGE_VIEW_TYPE_CUBE: case VK_IMAGE_VIEW_TYPE_CUBE_ARRAY: out << "samplerCube"; break;
+    case VK_IMAGE_VIEW_TYPE_1D: case VK_IMAGE_VIEW_TYPE_1D_ARRAY: out << "1D"; break;
+    case VK_IMAGE_VIEW_TYPE_2D: case VK_IMAGE_VIEW_TYPE_2D_ARRAY: out << "2D"; break;
+    case VK_IMAGE_VIEW_TYPE_3D: out << "3D"; break;
+    case VK_IMAGE_VIEW_TYPE_CUBE: case VK_IMAGE_VIEW_TYPE_CUBE_ARRAY: out << "Cube"; break;
+    default: break;
     }
-    if(t.value.is_multisampled) out << "MS";
-    if(t.value.view_type == VK_IMAGE_VIEW_TYPE_1D_ARRAY) out << "Array";
-    if(t.value.view_type == VK_IMAGE_VIEW_TYPE_2D_ARRAY) out << "Array";
-    if(t.value.view_type == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY) out << "Array";
-    if(t.value.is_shadow) out << "Shadow";
+    if(is_multisampled) out << "MS";
+    if(view_type == VK_IMAGE_VIEW_TYPE_1D_ARRAY) out << "Array";
+    if(view_type == VK_IMAGE_VIEW_TYPE_2D_ARRAY) out << "Array";
+    if(view_type == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY) out << "Array";
+    if(is_shadow) out << "Shadow";
+    return out;
+}
+
+std::ostream & operator << (std::ostream & out, indented<spvi::type::sampler> t)
+{
+    return print_opaque_type(out, "sampler", t.value.channel_kind, t.value.view_type, t.value.is_multisampled, t.value.is_shadow);
+}
+
+std::ostream & operator << (std::ostream & out, indented<spvi::type::image> t)
+{
+    print_opaque_type(out, t.value.is_storage ? "image" : "texture", t.value.channel_kind, t.value.view_type, t.value.is_multisampled, t.value.is_shadow);
+    if(t.value.format != VK_FORMAT_UNDEFINED) out << " /*format=" << t.value.format << "*/";
     return out;
 }
 
+std::ostream & operator << (std::ostream & out, indented<spvi::type::separate_sampler> t)
+{
+    return out << "sampler";
+}
+
 std::ostream & operator << (std::ostream & out, indented<spvi::type> t)
 {
     std::visit([&](const auto & x) { out << indented<std::remove_cv_t<std::remove_reference_t<decltype(x)>>>{x,t.indent}; }, t.value.contents);
     return out;
 }
 
-int main() try
+std::ostream & operator << (std::ostream & out, const spvi::specialization_constant_info & c)
 {
-    for(auto file : {"test.vert.spv", "test.frag.spv"})
+    out << "Constant " << c.constant_id << " " << c.name << " : ";
+    if(c.is_bool) return out << "bool = " << (c.default_value ? "true" : "false");
+    out << indented<spvi::type::numeric>{{c.elem_kind, c.elem_width, 1, 1, 0, 0},0} << " = ";
+    if(c.elem_kind == spvi::type::float_ && c.elem_width == 32) { float f; const uint32_t bits = static_cast<uint32_t>(c.default_value); memcpy(&f, &bits, sizeof(f)); return out << f; }
+    if(c.elem_kind == spvi::type::float_ && c.elem_width == 64) { double d; memcpy(&d, &c.default_value, sizeof(d)); return out << d; }
+    if(c.elem_kind == spvi::type::int_ && c.elem_width == 32) return out << static_cast<int32_t>(c.default_value);
+    return out << c.default_value;
+}
+
+const char * get_descriptor_type_name(VkDescriptorType type)
+{
+    switch(type)
     {
-        const spvi::module_info info(load_spirv_binary(file));
-
-        std::cout << "Module " << file << ":" << std::endl;
-        for(auto & desc_set : info.descriptor_sets)
-        {           
-            std::cout << "  Descriptor set " << desc_set.set << ":" << std::endl;
-            for(auto & desc : desc_set.descriptors)
-            {
-                std::cout << "    Descriptor " << desc.index << " " << desc.name << " : " << indented<spvi::type>{desc.type,4} << std::endl;
-            }
+    case VK_DESCRIPTOR_TYPE_SAMPLER: return "sampler";
+    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: return "combined image sampler";
+    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE: return "sampled image";
+    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: return "storage image";
+    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER: return "uniform buffer";
+    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER: return "storage buffer";
+    default: throw std::logic_error("bad descriptor type");
+    }
+}
+
+void print_module_info(std::ostream & out, const spvi::module_info & info)
+{
+    for(auto & desc_set : info.descriptor_sets)
+    {           
+        out << "  Descriptor set " << desc_set.set << ":" << std::endl;
+        for(auto & desc : desc_set.descriptors)
+        {
+            out << "    Descriptor " << desc.index << " (" << get_descriptor_type_name(desc.descriptor_type) << ") " << desc.name << " : " << indented<spvi::type>{desc.type,4} << std::endl;
         }
+    }
 
-        for(auto & e : info.entry_points)
+    if(!info.specialization_constants.empty()) out << "  Specialization constants:" << std::endl;
+    for(auto & c : info.specialization_constants) out << "    " << c << std::endl;
+
+    if(!info.push_constants.empty()) out << "  Push constants:" << std::endl;
+    for(auto & p : info.push_constants) out << "    " << p.name << " : " << indented<spvi::type>{p.type,4} << std::endl;
+
+    for(auto & e : info.entry_points)
+    {
+        out << "  ";
+        switch(e.stage)
         {
-            std::cout << "  ";
-            switch(e.stage)
-            {
-            case VK_SHADER_STAGE_VERTEX_BIT: std::cout << "Vertex"; break;
-            case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT: std::cout << "Tesselation control"; break;
-            case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: std::cout << "Tesselation evaluation"; break;
-            case VK_SHADER_STAGE_GEOMETRY_BIT: std::cout << "Geometry"; break;
-            case VK_SHADER_STAGE_FRAGMENT_BIT: std::cout << "Fragment"; break;
-            case VK_SHADER_STAGE_COMPUTE_BIT: std::cout << "Compute"; break;
-            default: throw std::logic_error("bad shader stage");
-            }
-            std::cout << " shader " << e.name << "(...):\n";
-            for(auto & i : e.inputs) std::cout << "    Input " << i.index << " " << i.name << " : " << indented<spvi::type>{i.type,4} << std::endl;
-            for(auto & i : e.outputs) std::cout << "    Output " << i.index << " " << i.name << " : " << indented<spvi::type>{i.type,4} << std::endl;
+        case VK_SHADER_STAGE_VERTEX_BIT: out << "Vertex"; break;
+        case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT: out << "Tesselation control"; break;
+        case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: out << "Tesselation evaluation"; break;
+        case VK_SHADER_STAGE_GEOMETRY_BIT: out << "Geometry"; break;
+        case VK_SHADER_STAGE_FRAGMENT_BIT: out << "Fragment"; break;
+        case VK_SHADER_STAGE_COMPUTE_BIT: out << "Compute"; break;
+        default: throw std::logic_error("bad shader stage");
         }
-        std::cout << std::endl;
+        out << " shader " << e.name << "(...):\n";
+        for(auto & i : e.inputs) out << "    Input " << i.index << " " << i.name << " : " << indented<spvi::type>{i.type,4} << std::endl;
+        for(auto & i : e.outputs) out << "    Output " << i.index << " " << i.name << " : " << indented<spvi::type>{i.type,4} << std::endl;
     }
-	return EXIT_SUCCESS;
+}
+
+// Prints where reflection spent its time over a corpus, along with the work done in each phase
+void print_profile(std::ostream & out, const spvi::reflection_profile & profile)
+{
+    const double n = static_cast<double>(std::max<uint64_t>(profile.module_count, 1));
+    auto print_phase = [&](const char * label, uint64_t nanoseconds) { out << "  " << std::left << std::setw(24) << label << std::right << std::fixed << std::setprecision(3) << std::setw(12) << nanoseconds * 1e-6 << " ms" << std::setw(12) << std::setprecision(1) << nanoseconds * 1e-3 / n << " us per module" << std::endl; };
+    auto print_count = [&](const char * label, uint64_t count) { out << "  " << std::left << std::setw(24) << label << std::right << std::setw(12) << count << std::endl; };
+
+    out << "Profile of " << profile.module_count << " modules:" << std::endl;
+    print_phase("load", profile.load_nanoseconds);
+    print_phase("convert types", profile.convert_nanoseconds);
+    print_phase("build trees", profile.tree_nanoseconds);
+    print_count("words", profile.word_count);
+    print_count("words skipped", profile.skipped_words);
+    print_count("type conversions", profile.type_conversions);
+    print_count("interned types", profile.interned_types);
+    print_count("tree types", profile.tree_types);
+    print_count("bytes allocated", profile.bytes_allocated);
+    if(profile.id_lookups || profile.name_lookups || profile.decoration_lookups)
+    {
+        print_count("id lookups", profile.id_lookups);
+        print_count("name lookups", profile.name_lookups);
+        print_count("decoration lookups", profile.decoration_lookups);
+        print_count("type cache hits", profile.type_cache_hits);
+    }
+    else out << "  (build with SPVI_COUNT_LOOKUPS=1 to count lookups)" << std::endl;
+
+    std::vector<std::pair<uint64_t, uint32_t>> op_codes;
+    for(size_t i=0; i<profile.op_code_counts.size(); ++i) if(profile.op_code_counts[i]) op_codes.push_back({profile.op_code_counts[i], static_cast<uint32_t>(i)});
+    std::sort(op_codes.rbegin(), op_codes.rend());
+    out << "Retained instructions by op code:" << std::endl;
+    for(auto & op : op_codes) print_count(spvi::get_op_code_name(op.second), op.first);
+}
+
+// Expands the command line arguments into a list of files, searching directories recursively for .spv files
+std::vector<std::string> find_input_files(const std::vector<std::string> & args)
+{
+    std::vector<std::string> files;
+    for(auto & arg : args)
+    {
+        if(!std::filesystem::is_directory(arg)) { files.push_back(arg); continue; }
+        const size_t first = files.size();
+        for(auto & entry : std::filesystem::recursive_directory_iterator(arg))
+        {
+            if(entry.is_regular_file() && entry.path().extension() == ".spv") files.push_back(entry.path().string());
+        }
+        std::sort(begin(files) + first, end(files));
+    }
+    return files;
+}
+
+int main(int argc, char * argv[]) try
+{
+    bool quiet = false, cpp = false, profiling = false;
+    std::vector<std::string> args;
+    for(int i=1; i<argc; ++i)
+    {
+        if(strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quiet") == 0) quiet = true;
+        else if(strcmp(argv[i], "--cpp") == 0) cpp = true;
+        else if(strcmp(argv[i], "--profile") == 0) profiling = true;
+        else args.push_back(argv[i]);
+    }
+    if(args.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " [-q|--quiet] [--cpp] [--profile] <file or directory>...\n\n"
+            "Reflects the interface of each SPIR-V binary. Directories are searched recursively for .spv files.\n"
+            "  -q, --quiet   Only report timing, without printing the interface of each module\n"
+            "  --cpp         Print a C++ header declaring the buffer blocks of all modules, and report timing on stderr\n"
+            "  --profile     Report the time spent in each phase of reflection and the work done, aggregated over all modules" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // When generating a header, standard output is reserved for the header itself
+    std::ostream & report = cpp ? std::clog : std::cout;
+    std::vector<spvi::module_info> infos;
+    spvi::reflection_profile profile;
+
+    typedef std::chrono::high_resolution_clock clock;
+    size_t file_count = 0, failure_count = 0, total_bytes = 0;
+    clock::duration total_time {};
+    for(auto & file : find_input_files(args))
+    {
+        ++file_count;
+        try
+        {
+            const auto t0 = clock::now();
+            const spvi::mapped_file mapping(file.c_str());
+            if(mapping.size() % sizeof(uint32_t)) throw std::runtime_error("file size is not a multiple of four bytes");
+            spvi::module_info info(mapping.words(), mapping.word_count(), profiling ? &profile : nullptr);
+            const auto elapsed = clock::now() - t0;
+            total_time += elapsed;
+            total_bytes += mapping.size();
+
+            report << "Module " << file << ": " << mapping.size() << " bytes in " 
+                << std::fixed << std::setprecision(1) << std::chrono::duration<double, std::micro>(elapsed).count() << " us" << std::endl;
+            if(cpp) infos.push_back(std::move(info));
+            if(quiet || cpp) continue;
+            print_module_info(std::cout, info);
+            std::cout << std::endl;
+        }
+        catch(const std::exception & e)
+        {
+            ++failure_count;
+            std::cerr << file << ": " << e.what() << std::endl;
+        }
+    }
+
+    if(cpp)
+    {
+        std::vector<const spvi::module_info *> modules;
+        for(auto & info : infos) modules.push_back(&info);
+        std::cout << spvi::generate_cpp_header(modules.data(), modules.size());
+    }
+
+    const double seconds = std::chrono::duration<double>(total_time).count();
+    report << "Reflected " << file_count - failure_count << " of " << file_count << " modules, " << total_bytes << " bytes in " 
+        << std::fixed << std::setprecision(3) << seconds*1e3 << " ms (" << std::setprecision(1) << (seconds > 0 ? total_bytes / seconds / 1e6 : 0.0) << " MB/s)" << std::endl;
+    if(profiling) print_profile(report, profile);
+    return failure_count ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 catch (const std::exception & e)
 {
@@ -0,0 +1,230 @@
+#include "spirv-archive.h"
+#include <cstring>
+#include <stdexcept>
+
+static_assert(sizeof(spvi::archived_type) == 48, "archived_type has padding");
+static_assert(sizeof(spvi::archived_member) == 16 && sizeof(spvi::archived_variable) == 16 && sizeof(spvi::archived_descriptor_set) == 12 && sizeof(spvi::archived_entry_point) == 24, "archive records have padding");
+static_assert(sizeof(spvi::archived_specialization_constant) == 32 && sizeof(spvi::archived_specialization_op) == 32, "archive records have padding");
+static_assert(sizeof(spvi::archive_header) == 16 + 16 * static_cast<size_t>(spvi::archive_section::count), "archive_header has padding");
+
+///////////
+// Write //
+///////////
+
+namespace
+{
+    uint32_t narrow(size_t value)
+    {
+        if(value >= spvi::archive_none) throw std::logic_error("value is too large to archive");
+        return static_cast<uint32_t>(value);
+    }
+    template<class T> uint32_t narrow(const std::optional<T> & value) { return value ? narrow(static_cast<size_t>(*value)) : spvi::archive_none; }
+
+    // Types are zeroed before they are filled in, so that the unused bytes of the union are written deterministically
+    template<class T> T zeroed() { T record; memset(&record, 0, sizeof(record)); return record; }
+
+    spvi::archived_type archive_type(const spvi::type_graph::node & n)
+    {
+        auto r = zeroed<spvi::archived_type>();
+        r.kind = static_cast<uint32_t>(n.contents.index());
+        r.size = n.size;
+        r.hash = n.hash;
+        if(auto * s = std::get_if<spvi::type::sampler>(&n.contents)) r.image = {static_cast<uint32_t>(s->channel_kind), static_cast<uint32_t>(s->view_type), s->is_multisampled, s->is_shadow, false, VK_FORMAT_UNDEFINED};
+        if(auto * x = std::get_if<spvi::type::numeric>(&n.contents)) r.numeric = {static_cast<uint32_t>(x->elem_kind), narrow(x->elem_width), narrow(x->row_count), narrow(x->column_count), narrow(x->row_stride), narrow(x->column_stride)};
+        if(auto * a = std::get_if<spvi::type_graph::array>(&n.contents)) r.array = {a->elem_type, narrow(a->elem_count), narrow(a->stride), narrow(a->elem_count_expression)};
+        if(auto * s = std::get_if<spvi::type_graph::structure>(&n.contents)) r.structure = {s->name, s->first_member, s->member_count};
+        if(auto * i = std::get_if<spvi::type::image>(&n.contents)) r.image = {static_cast<uint32_t>(i->channel_kind), static_cast<uint32_t>(i->view_type), i->is_multisampled, i->is_shadow, i->is_storage, static_cast<uint32_t>(i->format)};
+        return r;
+    }
+
+    spvi::archived_variable archive_variable(const spvi::flat_variable_info & v) { return {v.index, v.type, v.name, static_cast<uint32_t>(v.descriptor_type)}; }
+
+    // Converts each element of a vector into a record, for the arrays whose records differ from their flat_module_info equivalents
+    template<class R, class T, class F> std::vector<R> archive_all(const std::vector<T> & values, F archive_value)
+    {
+        std::vector<R> records;
+        records.reserve(values.size());
+        for(auto & v : values) records.push_back(archive_value(v));
+        return records;
+    }
+}
+
+std::vector<uint8_t> spvi::write_archive(const flat_module_info & info)
+{
+    auto header = zeroed<archive_header>();
+    std::vector<uint8_t> bytes(sizeof(header));
+    auto write_section = [&](archive_section section, const void * records, size_t count, size_t record_size)
+    {
+        bytes.resize((bytes.size() + 7) & ~size_t(7), 0);
+        header.sections[static_cast<size_t>(section)] = {bytes.size(), narrow(count), static_cast<uint32_t>(record_size)};
+        bytes.insert(bytes.end(), reinterpret_cast<const uint8_t *>(records), reinterpret_cast<const uint8_t *>(records) + count * record_size);
+    };
+    auto write_records = [&](archive_section section, const auto & records) { write_section(section, records.data(), records.size(), sizeof(records[0])); };
+
+    write_records(archive_section::types, archive_all<archived_type>(info.types.types, archive_type));
+    write_records(archive_section::members, archive_all<archived_member>(info.types.members, [](const type_graph::member & m) { return archived_member{m.name, m.member_type, narrow(m.offset), 0}; }));
+    write_records(archive_section::strings, info.types.strings);
+    write_records(archive_section::variables, archive_all<archived_variable>(info.variables, archive_variable));
+    write_records(archive_section::descriptor_sets, archive_all<archived_descriptor_set>(info.descriptor_sets, [](const flat_descriptor_set_info & s) { return archived_descriptor_set{s.set, s.first_descriptor, s.descriptor_count}; }));
+    write_records(archive_section::push_constants, archive_all<archived_variable>(info.push_constants, archive_variable));
+    write_records(archive_section::entry_points, archive_all<archived_entry_point>(info.entry_points, [](const flat_entry_point_info & e)
+    {
+        return archived_entry_point{static_cast<uint32_t>(e.stage), e.first_input, e.input_count, e.first_output, e.output_count, e.name};
+    }));
+    write_records(archive_section::specialization_constants, archive_all<archived_specialization_constant>(info.specialization_constants, [](const flat_specialization_constant_info & c)
+    {
+        return archived_specialization_constant{c.constant_id, c.name, static_cast<uint32_t>(c.elem_kind), narrow(c.elem_width), c.is_bool, 0, c.default_value};
+    }));
+    write_records(archive_section::specialization_program, archive_all<archived_specialization_op>(info.specialization_program, [](const specialization_op & op)
+    {
+        return archived_specialization_op{static_cast<uint32_t>(op.op), op.width, {op.operands[0], op.operands[1], op.operands[2]}, 0, op.value};
+    }));
+
+    header.magic = archive_header::expected_magic;
+    header.version = archive_header::current_version;
+    header.size = bytes.size();
+    memcpy(bytes.data(), &header, sizeof(header));
+    return bytes;
+}
+
+//////////
+// Read //
+//////////
+
+namespace
+{
+    [[noreturn]] void fail(const char * message) { throw std::runtime_error(message); }
+
+    bool is_range(uint32_t first, uint32_t count, size_t size) { return first <= size && count <= size - first; }
+
+    // Vulkan enumerations are only guaranteed to represent values up to their MAX_ENUM value
+    void check_enum(uint32_t value) { if(value > 0x7FFFFFFF) fail("archived enumerant is out of range"); }
+}
+
+spvi::archive_view::archive_view(const void * data, size_t size) : data{reinterpret_cast<const uint8_t *>(data)}, header{reinterpret_cast<const archive_header *>(data)}
+{
+    if(reinterpret_cast<uintptr_t>(data) % 8) fail("archive is not aligned to 8 bytes");
+    if(size < sizeof(archive_header)) fail("not an archive");
+    if(header->magic != archive_header::expected_magic)
+    {
+        if(header->magic == (archive_header::expected_magic >> 24 | (archive_header::expected_magic >> 8 & 0xFF00) | (archive_header::expected_magic << 8 & 0xFF0000) | archive_header::expected_magic << 24)) fail("archive was written with a different byte order");
+        fail("not an archive");
+    }
+    if(header->version != archive_header::current_version) fail("unsupported archive version");
+    if(header->size != size) fail("archive has the wrong size");
+
+    const size_t record_sizes[] {sizeof(archived_type), sizeof(archived_member), sizeof(char), sizeof(archived_variable), sizeof(archived_descriptor_set),
+        sizeof(archived_variable), sizeof(archived_entry_point), sizeof(archived_specialization_constant), sizeof(archived_specialization_op)};
+    static_assert(std::size(record_sizes) == static_cast<size_t>(archive_section::count), "missing record size");
+    for(size_t i=0; i<std::size(record_sizes); ++i)
+    {
+        auto & s = header->sections[i];
+        if(s.record_size != record_sizes[i]) fail("archive record has the wrong size");
+        if(s.offset % 8 || s.offset < sizeof(archive_header) || s.offset > size || s.count > (size - s.offset) / s.record_size) fail("archive section is out of bounds");
+    }
+
+    // Strings must be null terminated, so that every valid offset refers to a complete string
+    const auto strings = get_section<char>(archive_section::strings);
+    if(strings.size() && strings[strings.size()-1] != 0) fail("archive string table is not terminated");
+    auto check_string = [&](uint32_t offset) { if(offset >= strings.size()) fail("archive string is out of bounds"); };
+
+    // Types may only refer to types with lower indices, as in a type_graph, which rules out cycles
+    const auto types = get_types();
+    const auto members = get_members();
+    const auto program = get_specialization_program();
+    for(size_t i=0; i<types.size(); ++i)
+    {
+        auto & t = types[i];
+        switch(t.kind)
+        {
+        case 0: case 4:
+            if(t.image.channel_kind > type::uint_) fail("archived type has a bad number kind");
+            check_enum(t.image.view_type);
+            check_enum(t.image.format);
+            break;
+        case 1: if(t.numeric.elem_kind > type::uint_) fail("archived type has a bad number kind"); break;
+        case 2:
+            if(t.array.elem_type >= i) fail("archived array has a bad element type");
+            if(t.array.elem_count_expression != archive_none && t.array.elem_count_expression >= program.size()) fail("archived array has a bad length expression");
+            break;
+        case 3:
+            check_string(t.structure.name);
+            if(!is_range(t.structure.first_member, t.structure.member_count, members.size())) fail("archived structure has bad members");
+            for(auto & m : get_members(t))
+            {
+                check_string(m.name);
+                if(m.type >= i) fail("archived member has a bad type");
+            }
+            break;
+        case 5: break;
+        default: fail("archived type has a bad kind");
+        }
+    }
+
+    auto check_variables = [&](archive_range<archived_variable> variables)
+    {
+        for(auto & v : variables)
+        {
+            if(v.type >= types.size()) fail("archived variable has a bad type");
+            check_enum(v.descriptor_type);
+            check_string(v.name);
+        }
+    };
+    const auto variables = get_variables();
+    check_variables(variables);
+    check_variables(get_push_constants());
+    for(auto & s : get_descriptor_sets()) if(!is_range(s.first_descriptor, s.descriptor_count, variables.size())) fail("archived descriptor set has bad descriptors");
+    for(auto & e : get_entry_points())
+    {
+        if(!is_range(e.first_input, e.input_count, variables.size()) || !is_range(e.first_output, e.output_count, variables.size())) fail("archived entry point has bad variables");
+        check_string(e.name);
+        check_enum(e.stage);
+    }
+
+    const auto constants = get_specialization_constants();
+    for(auto & c : constants)
+    {
+        check_string(c.name);
+        if(c.elem_kind > type::uint_ || c.is_bool > 1) fail("archived specialization constant is malformed");
+    }
+    for(size_t i=0; i<program.size(); ++i)
+    {
+        // Operations may only refer to earlier operations, so that the program can be evaluated in a single pass
+        auto & op = program[i];
+        if(op.op > specialization_op::sge || op.width == 0 || op.width > 64) fail("archived specialization op is malformed");
+        if(op.op == specialization_op::constant && op.operands[0] >= constants.size()) fail("archived specialization op has a bad constant");
+        if(op.op != specialization_op::literal && op.op != specialization_op::constant) for(auto operand : op.operands) if(operand >= i) fail("archived specialization op has a bad operand");
+    }
+}
+
+spvi::flat_module_info spvi::archive_view::get_flat_module_info() const
+{
+    auto get_optional = [](uint32_t value) { return value == archive_none ? std::nullopt : std::optional<size_t>{value}; };
+    auto get_variable = [](const archived_variable & v) { return flat_variable_info{v.index, v.type, v.name, static_cast<VkDescriptorType>(v.descriptor_type)}; };
+
+    flat_module_info info;
+    for(auto & t : get_types())
+    {
+        type_graph::node n {{}, t.hash, static_cast<size_t>(t.size)};
+        switch(t.kind)
+        {
+        case 0: n.contents = type::sampler{static_cast<type::number_kind>(t.image.channel_kind), static_cast<VkImageViewType>(t.image.view_type), t.image.is_multisampled != 0, t.image.is_shadow != 0}; break;
+        case 1: n.contents = type::numeric{static_cast<type::number_kind>(t.numeric.elem_kind), t.numeric.elem_width, t.numeric.row_count, t.numeric.column_count, t.numeric.row_stride, t.numeric.column_stride}; break;
+        case 2: n.contents = type_graph::array{t.array.elem_type, t.array.elem_count, get_optional(t.array.stride), t.array.elem_count_expression == archive_none ? std::nullopt : std::optional<uint32_t>{t.array.elem_count_expression}}; break;
+        case 3: n.contents = type_graph::structure{t.structure.name, t.structure.first_member, t.structure.member_count}; break;
+        case 4: n.contents = type::image{static_cast<type::number_kind>(t.image.channel_kind), static_cast<VkImageViewType>(t.image.view_type), t.image.is_multisampled != 0, t.image.is_shadow != 0, t.image.is_storage != 0, static_cast<VkFormat>(t.image.format)}; break;
+        default: n.contents = type::separate_sampler{}; break;
+        }
+        info.types.types.push_back(n);
+    }
+    for(auto & m : get_members()) info.types.members.push_back({m.name, m.type, get_optional(m.offset)});
+    const auto strings = get_section<char>(archive_section::strings);
+    info.types.strings.assign(strings.begin(), strings.end());
+    for(auto & v : get_variables()) info.variables.push_back(get_variable(v));
+    for(auto & s : get_descriptor_sets()) info.descriptor_sets.push_back({s.set, s.first_descriptor, s.descriptor_count});
+    for(auto & p : get_push_constants()) info.push_constants.push_back(get_variable(p));
+    for(auto & e : get_entry_points()) info.entry_points.push_back({static_cast<VkShaderStageFlagBits>(e.stage), e.first_input, e.input_count, e.first_output, e.output_count, e.name});
+    for(auto & c : get_specialization_constants()) info.specialization_constants.push_back({c.constant_id, c.name, static_cast<type::number_kind>(c.elem_kind), c.elem_width, c.is_bool != 0, c.default_value});
+    for(auto & op : get_specialization_program()) info.specialization_program.push_back({static_cast<specialization_op::code>(op.op), op.width, {op.operands[0], op.operands[1], op.operands[2]}, op.value});
+    return info;
+}
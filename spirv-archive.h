@@ -0,0 +1,115 @@
+#pragma once
+#include "spirv-interface.h"
+
+namespace spvi
+{
+    // The records of an archive, which is a versioned binary encoding of a flat_module_info that can be read in place, such as from a memory-mapped file.
+    // Every record has a fixed size and layout, all references are indices into other arrays of the archive, and strings are stored once in a shared
+    // string table, so nothing needs to be decoded or allocated to read an archive. Values are stored in the byte order of the host which wrote them.
+    // Fields described as optional hold archive_none when absent.
+    constexpr uint32_t archive_none = 0xFFFFFFFF;
+
+    // A node of a type_graph. Which member of the union is used depends on kind, which is the index of the alternative within type::contents.
+    struct archived_type
+    {
+        struct numeric_fields { uint32_t elem_kind, elem_width, row_count, column_count, row_stride, column_stride; };
+        struct image_fields { uint32_t channel_kind, view_type, is_multisampled, is_shadow, is_storage, format; };   // Used for both images and samplers
+        struct array_fields { uint32_t elem_type, elem_count, stride, elem_count_expression; };                     // stride and elem_count_expression are optional
+        struct structure_fields { uint32_t name, first_member, member_count; };                                     // Members are a range within the archived members
+
+        uint32_t kind;
+        union
+        {
+            numeric_fields numeric;
+            image_fields image;
+            array_fields array;
+            structure_fields structure;
+        };
+        uint32_t reserved;
+        uint64_t size;  // As type_graph::node::size
+        uint64_t hash;  // As type_graph::node::hash
+    };
+
+    struct archived_member { uint32_t name, type, offset, reserved; };  // offset is optional
+    struct archived_variable { uint32_t index, type, name, descriptor_type; };
+    struct archived_descriptor_set { uint32_t set, first_descriptor, descriptor_count; };   // Descriptors are a range within the archived variables
+    struct archived_entry_point { uint32_t stage, first_input, input_count, first_output, output_count, name; };
+    struct archived_specialization_constant { uint32_t constant_id, name, elem_kind, elem_width, is_bool, reserved; uint64_t default_value; };
+    struct archived_specialization_op { uint32_t op, width, operands[3], reserved; uint64_t value; };
+
+    // The arrays of an archive, in the order in which they are stored
+    enum class archive_section : uint32_t { types, members, strings, variables, descriptor_sets, push_constants, entry_points, specialization_constants, specialization_program, count };
+
+    struct archive_header
+    {
+        static constexpr uint32_t expected_magic = 0x41565053;  // 'SPVA'
+        static constexpr uint32_t current_version = 1;          // Must be incremented whenever the layout of any record changes
+
+        struct section_info
+        {
+            uint64_t offset;        // Offset in bytes from the start of the archive, which is a multiple of 8
+            uint32_t count;         // Number of records
+            uint32_t record_size;   // Size in bytes of each record
+        };
+
+        uint32_t magic;
+        uint32_t version;
+        uint64_t size;              // Size in bytes of the whole archive
+        section_info sections[static_cast<size_t>(archive_section::count)];
+    };
+
+    // A contiguous array of records within an archive
+    template<class T> struct archive_range
+    {
+        const T * first, * last;
+        const T * begin() const { return first; }
+        const T * end() const { return last; }
+        size_t size() const { return last - first; }
+        const T & operator[] (size_t i) const { return first[i]; }
+    };
+
+    // Encodes a module as an archive. The module_info overload flattens the module first, merging identical types.
+    std::vector<uint8_t> write_archive(const flat_module_info & info);
+    inline std::vector<uint8_t> write_archive(const module_info & info) { return write_archive(flat_module_info{info}); }
+
+    // Read-only access to an archive owned by the caller, which must remain valid, and be aligned to 8 bytes, for as long as the view is used.
+    // The whole archive is validated on construction, so that every index and range it contains can then be followed without further checks.
+    class archive_view
+    {
+        const uint8_t * data = nullptr;
+        const archive_header * header = nullptr;
+
+        template<class T> archive_range<T> get_section(archive_section section) const
+        {
+            if(!header) return {nullptr, nullptr};
+            auto & s = header->sections[static_cast<size_t>(section)];
+            auto first = reinterpret_cast<const T *>(data + s.offset);
+            return {first, first + s.count};
+        }
+    public:
+        archive_view() = default;
+
+        // Throws std::runtime_error if the data is not an archive of the current version, was written on a host with a different byte order, or is malformed
+        archive_view(const void * data, size_t size);
+
+        archive_range<archived_type> get_types() const { return get_section<archived_type>(archive_section::types); }
+        archive_range<archived_member> get_members() const { return get_section<archived_member>(archive_section::members); }
+        archive_range<archived_variable> get_variables() const { return get_section<archived_variable>(archive_section::variables); }
+        archive_range<archived_descriptor_set> get_descriptor_sets() const { return get_section<archived_descriptor_set>(archive_section::descriptor_sets); }
+        archive_range<archived_variable> get_push_constants() const { return get_section<archived_variable>(archive_section::push_constants); }
+        archive_range<archived_entry_point> get_entry_points() const { return get_section<archived_entry_point>(archive_section::entry_points); }
+        archive_range<archived_specialization_constant> get_specialization_constants() const { return get_section<archived_specialization_constant>(archive_section::specialization_constants); }
+        archive_range<archived_specialization_op> get_specialization_program() const { return get_section<archived_specialization_op>(archive_section::specialization_program); }
+
+        const char * get_string(uint32_t offset) const { return get_section<char>(archive_section::strings).first + offset; }
+        const archived_type & get_type(uint32_t index) const { return get_types()[index]; }
+        archive_range<archived_member> get_members(const archived_type & structure) const { auto m = get_members().first + structure.structure.first_member; return {m, m + structure.structure.member_count}; }
+        archive_range<archived_variable> get_descriptors(const archived_descriptor_set & set) const { auto v = get_variables().first + set.first_descriptor; return {v, v + set.descriptor_count}; }
+        archive_range<archived_variable> get_inputs(const archived_entry_point & entry) const { auto v = get_variables().first + entry.first_input; return {v, v + entry.input_count}; }
+        archive_range<archived_variable> get_outputs(const archived_entry_point & entry) const { auto v = get_variables().first + entry.first_output; return {v, v + entry.output_count}; }
+
+        // Copies the archive into a flat_module_info, or into the equivalent tree-based module_info
+        flat_module_info get_flat_module_info() const;
+        module_info get_module_info() const { return module_info{get_flat_module_info()}; }
+    };
+}
@@ -0,0 +1,142 @@
+#include "spirv-block-map.h"
+#include <cctype>
+#include <stdexcept>
+
+namespace
+{
+    // True if a path names the canonical path of a field, ignoring the digits of its array indices
+    bool matches_path(const char * path, const char * canonical)
+    {
+        for(bool in_index = false; *path; ++path)
+        {
+            if(*path == '[') in_index = true;
+            else if(*path == ']') in_index = false;
+            else if(in_index) continue;
+            if(*path != *canonical++) return false;
+        }
+        return *canonical == 0;
+    }
+}
+
+spvi::block_map::block_map(const type & block)
+{
+    auto * s = std::get_if<type::structure>(&block.contents);
+    if(!s) throw std::logic_error("block is not a structure");
+    block_size = s->size;
+
+    std::string path;
+    std::vector<block_dimension> outer_dimensions;
+    add_fields(block, path, 0, outer_dimensions);
+
+    // Keep the table at most half full, so that probe sequences stay short
+    size_t capacity = 4;
+    while(capacity < fields.size() * 2) capacity *= 2;
+    slots.resize(capacity, 0);
+    for(size_t i=0; i<fields.size(); ++i)
+    {
+        if(find(fields[i].token)) throw std::logic_error("two fields of the block have the same hash");
+        size_t slot = fields[i].token & (capacity - 1);
+        while(slots[slot]) slot = (slot + 1) & (capacity - 1);
+        slots[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+void spvi::block_map::add_fields(const type & t, std::string & path, size_t offset, std::vector<block_dimension> & outer_dimensions)
+{
+    if(auto * x = std::get_if<type::numeric>(&t.contents))
+    {
+        block_field f {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(dimensions.size()), static_cast<uint32_t>(outer_dimensions.size()), hash_path(path.c_str()), offset, get_numeric_size(*x), *x};
+        strings.insert(strings.end(), path.c_str(), path.c_str() + path.size() + 1);
+        dimensions.insert(dimensions.end(), outer_dimensions.begin(), outer_dimensions.end());
+        fields.push_back(f);
+        return;
+    }
+    if(auto * a = std::get_if<type::array>(&t.contents))
+    {
+        if(outer_dimensions.size() == max_dimensions) throw std::logic_error("field is nested within too many arrays");
+        const type & elem_type = a->elem_type;
+        outer_dimensions.push_back({a->stride ? *a->stride : 0, a->elem_count});
+        if(!a->stride)
+        {
+            // Without an explicit stride, elements are assumed to be tightly packed
+            if(auto * x = std::get_if<type::numeric>(&elem_type.contents)) outer_dimensions.back().stride = get_numeric_size(*x);
+            else if(auto * s = std::get_if<type::structure>(&elem_type.contents)) outer_dimensions.back().stride = s->size;
+        }
+        const size_t length = path.size();
+        path += "[]";
+        add_fields(elem_type, path, offset, outer_dimensions);
+        path.resize(length);
+        outer_dimensions.pop_back();
+        return;
+    }
+    if(auto * s = std::get_if<type::structure>(&t.contents))
+    {
+        const size_t length = path.size();
+        for(size_t i=0; i<s->members.size(); ++i)
+        {
+            auto & m = s->members[i];
+            if(!m.offset) throw std::logic_error("member has no explicit layout");
+            if(length) path += '.';
+            path += m.name.empty() ? std::to_string(i) : m.name;
+            add_fields(m.member_type, path, offset + *m.offset, outer_dimensions);
+            path.resize(length);
+        }
+        return;
+    }
+    throw std::logic_error("opaque type in block");
+}
+
+const spvi::block_field * spvi::block_map::find(uint64_t token) const
+{
+    if(slots.empty()) return nullptr;
+    const size_t mask = slots.size() - 1;
+    for(size_t slot = token & mask; slots[slot]; slot = (slot + 1) & mask)
+    {
+        const block_field & f = fields[slots[slot] - 1];
+        if(f.token == token) return &f;
+    }
+    return nullptr;
+}
+
+spvi::block_location spvi::block_map::locate(const char * path) const
+{
+    // Hash the path and parse its indices in a single pass
+    size_t indices[max_dimensions], index_count = 0;
+    uint64_t h = 0xcbf29ce484222325;
+    for(const char * p = path; *p; ++p)
+    {
+        if(*p == '[')
+        {
+            if(index_count == max_dimensions || !isdigit(static_cast<unsigned char>(p[1]))) return {nullptr, 0};
+            size_t index = 0;
+            while(isdigit(static_cast<unsigned char>(*++p))) index = index * 10 + (*p - '0');
+            if(*p != ']') return {nullptr, 0};
+            indices[index_count++] = index;
+            h = (h ^ '[') * 0x100000001b3;
+        }
+        h = (h ^ static_cast<uint8_t>(*p)) * 0x100000001b3;
+    }
+
+    // The table is keyed by hash alone, so confirm the name before returning a field
+    const block_field * f = find(h);
+    if(!f || !matches_path(path, get_path(*f))) return {nullptr, 0};
+    return get_location(f, indices, index_count);
+}
+
+spvi::block_location spvi::block_map::locate(uint64_t token, const size_t * indices, size_t index_count) const
+{
+    return get_location(find(token), indices, index_count);
+}
+
+spvi::block_location spvi::block_map::get_location(const block_field * f, const size_t * indices, size_t index_count) const
+{
+    if(!f || index_count != f->dimension_count) return {nullptr, 0};
+    size_t offset = f->offset;
+    const block_dimension * d = get_dimensions(*f);
+    for(size_t i=0; i<index_count; ++i)
+    {
+        if(d[i].elem_count && indices[i] >= d[i].elem_count) return {nullptr, 0};
+        offset += indices[i] * d[i].stride;
+    }
+    return {f, offset};
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "spirv-interface.h"
+#include <initializer_list>
+
+namespace spvi
+{
+    // One dimension of an array which contains a field, possibly an array of structures somewhere above it in the block
+    struct block_dimension
+    {
+        size_t stride;      // Distance in bytes between consecutive elements
+        size_t elem_count;  // Zero for runtime arrays, whose indices are not bounds checked
+    };
+
+    // A scalar, vector or matrix within a block, which may be repeated by the arrays that contain it
+    struct block_field
+    {
+        uint32_t path;                              // Offset of the canonical path of the field within the block map's string pool
+        uint32_t first_dimension, dimension_count;  // Range within the block map's dimensions, outermost first
+        uint64_t token;                             // Equal to block_map::hash_path of the path
+        size_t offset;                              // Offset in bytes from the start of the block when every array index is zero
+        size_t size;                                // Size in bytes of a single instance of the field
+        type::numeric numeric;                      // Kind, width, shape and strides of the field
+    };
+
+    // The address of a single instance of a field, as returned by block_map::locate
+    struct block_location
+    {
+        const block_field * field;  // Null if the path does not name a field or an index is out of bounds
+        size_t offset;              // Offset in bytes from the start of the block
+
+        explicit operator bool () const { return field != nullptr; }
+    };
+
+    // A flattened index of the fields within a uniform buffer, storage buffer or push constant block, for writing values by name.
+    // Fields are named by their full dotted path, such as "lights[3].color". Arrays are not expanded, instead each field is stored once under
+    // its canonical path, with array indices left empty as in "lights[].color", and the offset of an element is computed from the strides
+    // of the arrays which contain it. Lookups hash the path while parsing its indices, and probe an open addressed table, without allocating.
+    // Members without a debug name are named by their decimal member index.
+    class block_map
+    {
+        std::vector<block_field> fields;
+        std::vector<block_dimension> dimensions;
+        std::vector<char> strings;
+        std::vector<uint32_t> slots;    // Open addressed hash table of one plus the index of a field, or zero for an empty slot
+        size_t block_size = 0;
+
+        void add_fields(const type & t, std::string & path, size_t offset, std::vector<block_dimension> & outer_dimensions);
+        block_location get_location(const block_field * field, const size_t * indices, size_t index_count) const;
+    public:
+        static constexpr size_t max_dimensions = 8;
+
+        // Hashes a field path, ignoring the digits of any array indices, so that "lights[3].color" and "lights[].color" have the same hash.
+        // As this is constexpr, the tokens of well known fields can be computed at compile time and passed to locate() directly.
+        static constexpr uint64_t hash_path(const char * path)
+        {
+            uint64_t h = 0xcbf29ce484222325; // FNV-1a
+            for(bool in_index = false; *path; ++path)
+            {
+                if(*path == '[') in_index = true;
+                else if(*path == ']') in_index = false;
+                else if(in_index) continue;
+                h = (h ^ static_cast<uint8_t>(*path)) * 0x100000001b3;
+            }
+            return h;
+        }
+
+        block_map() = default;
+
+        // Indexes every field of a block, which must be a structure with explicit member offsets. Throws std::logic_error if the block contains
+        // opaque types, if fields are nested within more than max_dimensions arrays, or if two distinct paths have the same hash.
+        explicit block_map(const type & block);
+
+        const std::vector<block_field> & get_fields() const { return fields; }
+        const char * get_path(const block_field & field) const { return strings.data() + field.path; }
+        const block_dimension * get_dimensions(const block_field & field) const { return dimensions.data() + field.first_dimension; }
+        size_t get_block_size() const { return block_size; }
+
+        // Finds a field by the hash of its path, or returns nullptr if the block has no such field
+        const block_field * find(uint64_t token) const;
+
+        // Finds the instance of a field named by a full path, such as "lights[3].color". Every array containing the field must be indexed.
+        block_location locate(const char * path) const;
+
+        // Finds the instance of a field by the hash of its canonical path and one index for each array which contains it, outermost first
+        block_location locate(uint64_t token, const size_t * indices, size_t index_count) const;
+        block_location locate(uint64_t token, std::initializer_list<size_t> indices) const { return locate(token, indices.begin(), indices.size()); }
+    };
+}
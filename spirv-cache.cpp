@@ -0,0 +1,160 @@
+#include "spirv-cache.h"
+#include "spirv-archive.h"
+#include "mapped-file.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <random>
+#include <thread>
+
+/////////////
+// Hashing //
+/////////////
+
+namespace
+{
+    const uint64_t prime64_1 = 0x9E3779B185EBCA87ULL, prime64_2 = 0xC2B2AE3D27D4EB4FULL, prime64_3 = 0x165667B19E3779F9ULL, prime64_4 = 0x85EBCA77C2B2AE63ULL, prime64_5 = 0x27D4EB2F165667C5ULL;
+
+    uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+    uint64_t read64(const uint8_t * p) { uint64_t x; memcpy(&x, p, sizeof(x)); return x; }
+    uint32_t read32(const uint8_t * p) { uint32_t x; memcpy(&x, p, sizeof(x)); return x; }
+    uint64_t xxh64_round(uint64_t acc, uint64_t input) { return rotl(acc + input * prime64_2, 31) * prime64_1; }
+    uint64_t merge_round(uint64_t acc, uint64_t value) { return (acc ^ xxh64_round(0, value)) * prime64_1 + prime64_4; }
+
+    uint64_t xxhash64(const uint8_t * data, size_t size, uint64_t seed)
+    {
+        const uint8_t * p = data, * const end = data + size;
+        uint64_t h;
+        if(size >= 32)
+        {
+            uint64_t v1 = seed + prime64_1 + prime64_2, v2 = seed + prime64_2, v3 = seed, v4 = seed - prime64_1;
+            for(; p + 32 <= end; p += 32)
+            {
+                v1 = xxh64_round(v1, read64(p));
+                v2 = xxh64_round(v2, read64(p+8));
+                v3 = xxh64_round(v3, read64(p+16));
+                v4 = xxh64_round(v4, read64(p+24));
+            }
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge_round(merge_round(merge_round(merge_round(h, v1), v2), v3), v4);
+        }
+        else h = seed + prime64_5;
+
+        h += size;
+        for(; p + 8 <= end; p += 8) h = rotl(h ^ xxh64_round(0, read64(p)), 27) * prime64_1 + prime64_4;
+        if(p + 4 <= end) { h = rotl(h ^ (read32(p) * prime64_1), 23) * prime64_2 + prime64_3; p += 4; }
+        for(; p < end; ++p) h = rotl(h ^ (*p * prime64_5), 11) * prime64_1;
+
+        h ^= h >> 33; h *= prime64_2;
+        h ^= h >> 29; h *= prime64_3;
+        h ^= h >> 32;
+        return h;
+    }
+}
+
+uint64_t spvi::hash_words(const uint32_t * words, size_t word_count)
+{
+    return xxhash64(reinterpret_cast<const uint8_t *>(words), word_count * sizeof(uint32_t), 0);
+}
+
+///////////
+// Cache //
+///////////
+
+namespace
+{
+    // Must be incremented whenever cache_header changes. The payload is an archive, which is versioned separately, and which does not depend on
+    // the in-memory layout of the reflected types.
+    const uint32_t cache_format_version = 4;
+
+    struct cache_header
+    {
+        uint32_t magic;             // Always 'SPVC'
+        uint32_t format_version;    // Always cache_format_version
+        uint64_t binary_hash;       // hash_words() of the binary which was reflected
+        uint64_t binary_word_count; // Length of the binary which was reflected
+        uint64_t payload_size;      // Number of bytes of archive following the header
+        uint64_t payload_hash;      // xxhash64() of the payload, to detect truncated or corrupted entries
+    };
+    static_assert(sizeof(cache_header) % 8 == 0, "the archive following cache_header must be aligned to 8 bytes");
+    const uint32_t cache_magic = 0x43565053;
+
+    std::string get_entry_path(const std::string & directory, uint64_t hash)
+    {
+        std::ostringstream ss;
+        ss << std::hex << std::setw(16) << std::setfill('0') << hash << ".spvc";
+        return (std::filesystem::path(directory) / ss.str()).string();
+    }
+}
+
+spvi::reflection_cache::reflection_cache(std::string directory) : directory{std::move(directory)}
+{
+    std::filesystem::create_directories(this->directory);
+}
+
+spvi::module_info spvi::reflection_cache::reflect(const uint32_t * words, size_t word_count)
+{
+    if(auto info = load(words, word_count)) return std::move(*info);
+    module_info info(words, word_count);
+    try { store(words, word_count, info); }
+    catch(const std::exception &) {} // The cache is best-effort, and an entry which cannot be written, such as in a read-only or full directory, only costs a later miss
+    return info;
+}
+
+std::optional<spvi::module_info> spvi::reflection_cache::load(const uint32_t * words, size_t word_count) const
+{
+    const uint64_t hash = hash_words(words, word_count);
+    const std::string path = get_entry_path(directory, hash);
+    if(!std::filesystem::exists(path)) return std::nullopt;
+
+    try
+    {
+        const mapped_file entry(path.c_str());
+        cache_header header;
+        if(entry.size() < sizeof(header)) return std::nullopt;
+        memcpy(&header, entry.data(), sizeof(header));
+        if(header.magic != cache_magic || header.format_version != cache_format_version) return std::nullopt;
+        if(header.binary_hash != hash || header.binary_word_count != word_count || header.payload_size != entry.size() - sizeof(header)) return std::nullopt;
+
+        const uint8_t * payload = reinterpret_cast<const uint8_t *>(entry.data()) + sizeof(header);
+        if(xxhash64(payload, header.payload_size, 0) != header.payload_hash) return std::nullopt;
+        return archive_view{payload, static_cast<size_t>(header.payload_size)}.get_module_info();
+    }
+    catch(const std::runtime_error &)
+    {
+        // An unreadable or malformed entry is treated as a cache miss, and will be replaced by the next store
+        return std::nullopt;
+    }
+}
+
+void spvi::reflection_cache::store(const uint32_t * words, size_t word_count, const module_info & info) const
+{
+    const uint64_t hash = hash_words(words, word_count);
+    const auto payload = write_archive(info);
+    const cache_header header {cache_magic, cache_format_version, hash, word_count, payload.size(), xxhash64(payload.data(), payload.size(), 0)};
+
+    // Write to a file unique to this thread and then rename it into place, so that concurrent readers never observe a partial entry. Thread IDs
+    // are only unique within a process, so a random suffix keeps processes sharing the cache directory from writing to the same file.
+    const std::string path = get_entry_path(directory, hash);
+    std::ostringstream temp_path;
+    temp_path << path << '.' << std::this_thread::get_id() << '.' << std::hex << std::random_device{}() << ".tmp";
+    try
+    {
+        {
+            std::ofstream out(temp_path.str(), std::ofstream::binary);
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char *>(payload.data()), payload.size());
+            if(!out) throw std::runtime_error("unable to write " + temp_path.str());
+        }
+        std::filesystem::rename(temp_path.str(), path);
+    }
+    catch(const std::runtime_error &)
+    {
+        // Renaming can fail even after a complete write, such as over an entry which another process has mapped on Windows
+        std::error_code ec;
+        std::filesystem::remove(temp_path.str(), ec);
+        throw;
+    }
+}
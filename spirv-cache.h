@@ -0,0 +1,30 @@
+#pragma once
+#include "spirv-interface.h"
+
+namespace spvi
+{
+    // Fast 64-bit hash of the contents of a SPIR-V binary, using the xxHash64 algorithm
+    uint64_t hash_words(const uint32_t * words, size_t word_count);
+
+    // A persistent, on-disk cache of reflection results, keyed by the hash of each SPIR-V binary. Each entry is stored as its
+    // own file within the cache directory, holding an archive as written by write_archive, and is memory-mapped and validated
+    // against the cache format, the binary's hash and length, and the archive version before use.
+    class reflection_cache
+    {
+        std::string directory;
+    public:
+        explicit reflection_cache(std::string directory); // Creates the directory if it does not already exist
+
+        // Returns the cached reflection of a binary if a valid entry exists, or reflects the binary and stores the result. Failing to store
+        // the result is not an error, so this only throws if reflection itself fails.
+        module_info reflect(const uint32_t * words, size_t word_count);
+        module_info reflect(const std::vector<uint32_t> & words) { return reflect(words.data(), words.size()); }
+
+        // Returns the cached reflection of a binary, or std::nullopt if there is no valid entry
+        std::optional<module_info> load(const uint32_t * words, size_t word_count) const;
+
+        // Stores the reflection of a binary, replacing any existing entry. Throws std::runtime_error if the entry cannot be written, or
+        // std::logic_error if the reflection has a value too large to archive.
+        void store(const uint32_t * words, size_t word_count, const module_info & info) const;
+    };
+}
@@ -0,0 +1,192 @@
+#include "spirv-codegen.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    const char * get_scalar_name(const spvi::type::numeric & x)
+    {
+        switch(x.elem_kind)
+        {
+        case spvi::type::float_: if(x.elem_width == 32) return "float"; if(x.elem_width == 64) return "double"; break;
+        case spvi::type::int_: switch(x.elem_width) { case 8: return "std::int8_t"; case 16: return "std::int16_t"; case 32: return "std::int32_t"; case 64: return "std::int64_t"; } break;
+        case spvi::type::uint_: switch(x.elem_width) { case 8: return "std::uint8_t"; case 16: return "std::uint16_t"; case 32: return "std::uint32_t"; case 64: return "std::uint64_t"; } break;
+        }
+        throw std::logic_error("type has no C++ equivalent");
+    }
+
+    // Turns a SPIR-V debug name, which may contain characters such as '.', into a valid C++ identifier which is not a keyword
+    std::string get_identifier(const std::string & name)
+    {
+        static const std::unordered_set<std::string> keywords {"alignas", "alignof", "and", "asm", "auto", "bool", "break", "case", "catch", "char", "class", "const", "constexpr", "const_cast",
+            "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline",
+            "int", "long", "mutable", "namespace", "new", "noexcept", "not", "nullptr", "operator", "or", "private", "protected", "public", "register", "reinterpret_cast", "return", "short",
+            "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename",
+            "union", "unsigned", "using", "virtual", "void", "volatile", "while", "xor"};
+        std::string r = name.empty() ? "unnamed" : name;
+        for(auto & c : r) if(!isalnum(static_cast<unsigned char>(c)) && c != '_') c = '_';
+        if(isdigit(static_cast<unsigned char>(r[0])) || keywords.count(r)) r += '_';
+        return r;
+    }
+
+    // Joins a base type and a declarator, such as "float" and "tint[4]", or "float" and "[4]" for an abstract declarator
+    std::string join(const std::string & base, const std::string & declarator) { return declarator.empty() || declarator[0] == '[' ? base + declarator : base + " " + declarator; }
+
+    // Declares the structures of blocks, each only once, writing the declarations of nested structures ahead of the structures which contain them
+    class cpp_header_writer
+    {
+        std::ostringstream out;
+        std::unordered_map<spvi::type, std::string> struct_names;
+        std::unordered_set<std::string> used_names;
+
+        static size_t get_scalar_size(const spvi::type::numeric & x) { return x.elem_width / 8; }
+
+        static size_t get_column_stride(const spvi::type::numeric & x) { return x.column_stride ? x.column_stride : x.row_count * get_scalar_size(x); }
+
+        // The alignment of the C++ declaration of a type, which is the alignment of its largest scalar
+        static size_t get_alignment(const spvi::type & t)
+        {
+            if(auto * x = std::get_if<spvi::type::numeric>(&t.contents)) return get_scalar_size(*x);
+            if(auto * a = std::get_if<spvi::type::array>(&t.contents)) return get_alignment(a->elem_type);
+            if(auto * s = std::get_if<spvi::type::structure>(&t.contents))
+            {
+                size_t alignment = 1;
+                for(auto & m : s->members) alignment = std::max(alignment, get_alignment(m.member_type));
+                return alignment;
+            }
+            throw std::logic_error("opaque type in block");
+        }
+
+        // The size of the C++ declaration of a type, which for structures is rounded up to their alignment
+        static size_t get_cpp_size(const spvi::type & t)
+        {
+            if(auto * x = std::get_if<spvi::type::numeric>(&t.contents)) return spvi::get_numeric_size(*x);
+            if(auto * a = std::get_if<spvi::type::array>(&t.contents)) return a->elem_count * (a->stride ? *a->stride : get_cpp_size(a->elem_type));
+            if(auto * s = std::get_if<spvi::type::structure>(&t.contents)) { const size_t alignment = get_alignment(t); return (s->size + alignment - 1) / alignment * alignment; }
+            throw std::logic_error("opaque type in block");
+        }
+
+        std::string declare(const spvi::type & t, const std::string & declarator)
+        {
+            if(auto * x = std::get_if<spvi::type::numeric>(&t.contents))
+            {
+                if(x->column_count == 1) return join(get_scalar_name(*x), x->row_count == 1 ? declarator : declarator + "[" + std::to_string(x->row_count) + "]");
+
+                // Rows of a row-major matrix, or otherwise columns, which are padded to their stride include the padding as extra components
+                if(spvi::is_row_major(*x))
+                {
+                    if(x->row_stride < x->column_count * get_scalar_size(*x) || x->row_stride % get_scalar_size(*x)) throw std::logic_error("matrix stride is not a whole number of components");
+                    return join(get_scalar_name(*x), declarator + "[" + std::to_string(x->row_count) + "][" + std::to_string(x->row_stride / get_scalar_size(*x)) + "]");
+                }
+                const size_t column_stride = get_column_stride(*x);
+                if(column_stride < x->row_count * get_scalar_size(*x) || column_stride % get_scalar_size(*x)) throw std::logic_error("matrix stride is not a whole number of components");
+                return join(get_scalar_name(*x), declarator + "[" + std::to_string(x->column_count) + "][" + std::to_string(column_stride / get_scalar_size(*x)) + "]");
+            }
+            if(auto * a = std::get_if<spvi::type::array>(&t.contents))
+            {
+                if(a->elem_count == 0) throw std::logic_error("runtime array is not the last member of a block");
+                const std::string dimension = "[" + std::to_string(a->elem_count) + "]";
+                const size_t elem_size = get_cpp_size(a->elem_type);
+                if(!a->stride || *a->stride == elem_size) return declare(a->elem_type, declarator + dimension);
+                if(*a->stride < elem_size || *a->stride % get_alignment(a->elem_type)) throw std::logic_error("array stride cannot be represented");
+                return join("spvi_padded<" + declare(a->elem_type, "") + ", " + std::to_string(*a->stride) + ">", declarator + dimension);
+            }
+            if(std::holds_alternative<spvi::type::structure>(t.contents)) return join(declare_struct(t, nullptr), declarator);
+            throw std::logic_error("opaque type in block");
+        }
+    public:
+        // Returns the name of the C++ struct for a structure, declaring it first if necessary, preceded by the given comment
+        std::string declare_struct(const spvi::type & t, const char * comment)
+        {
+            auto it = struct_names.find(t);
+            if(it != struct_names.end()) return it->second;
+            auto * block = std::get_if<spvi::type::structure>(&t.contents);
+            if(!block) throw std::logic_error("block is not a structure");
+            auto & s = *block;
+
+            // Building the members declares any nested structures, so the declaration of this struct is only written once they are complete
+            std::ostringstream members, asserts;
+            size_t offset = 0, padding_count = 0;
+            auto pad_to = [&](size_t target) { if(target > offset) members << "    std::uint8_t _padding" << padding_count++ << "[" << target - offset << "];\n"; offset = target; };
+            for(auto & m : s.members)
+            {
+                if(!m.offset) throw std::logic_error("member has no explicit layout");
+                if(*m.offset < offset) throw std::logic_error("member overlaps the previous member");
+                const std::string name = get_identifier(m.name);
+                const spvi::type & member_type = m.member_type;
+                if(auto * a = std::get_if<spvi::type::array>(&member_type.contents); a && a->elem_count == 0)
+                {
+                    if(&m != &s.members.back()) throw std::logic_error("runtime array is not the last member of a block");
+                    members << "    // Followed by a runtime array " << name << " of " << declare(a->elem_type, "") << " at offset " << *m.offset;
+                    if(a->stride) members << ", with a stride of " << *a->stride << " bytes";
+                    members << "\n";
+                    continue;
+                }
+
+                pad_to(*m.offset);
+                members << "    " << declare(member_type, name) << ";";
+                if(auto * a = std::get_if<spvi::type::array>(&member_type.contents); a && a->elem_count_expression) members << " // Length depends on specialization constants";
+                members << "\n";
+                asserts << "static_assert(offsetof(@, " << name << ") == " << *m.offset << ");\n";
+                offset += get_cpp_size(member_type);
+            }
+            pad_to(s.size);
+
+            std::string name = get_identifier(s.name);
+            for(int suffix=2; used_names.count(name); ++suffix) name = get_identifier(s.name) + "_" + std::to_string(suffix);
+            used_names.insert(name);
+            struct_names.emplace(t, name);
+
+            if(comment) out << "// " << comment << "\n";
+            out << "struct " << name << "\n{\n" << members.str() << "};\n";
+            std::string checks = asserts.str();
+            for(size_t i = checks.find('@'); i != std::string::npos; i = checks.find('@', i)) checks.replace(i, 1, name);
+            // A struct holding nothing but a runtime array is empty, which C++ still gives a size of one byte
+            out << checks << "static_assert(sizeof(" << name << ") == " << std::max<size_t>(get_cpp_size(t), 1) << ");\n\n";
+            return name;
+        }
+
+        std::string str() const
+        {
+            return "// Generated from reflected SPIR-V by read-spirv\n"
+                "#pragma once\n"
+                "#include <cstddef>\n"
+                "#include <cstdint>\n\n"
+                "#ifndef SPVI_PADDED_DEFINED\n"
+                "#define SPVI_PADDED_DEFINED\n"
+                "// An array element followed by padding up to the stride of the array\n"
+                "template<class T, std::size_t Stride> struct spvi_padded { T value; std::uint8_t padding[Stride - sizeof(T)]; };\n"
+                "#endif\n\n" + out.str();
+        }
+    };
+
+    // Arrays of blocks are declared in terms of the block itself
+    const spvi::type & get_block_type(const spvi::type & t)
+    {
+        if(auto * a = std::get_if<spvi::type::array>(&t.contents)) return get_block_type(a->elem_type);
+        return t;
+    }
+}
+
+std::string spvi::generate_cpp_header(const module_info * const * modules, size_t module_count)
+{
+    cpp_header_writer writer;
+    for(size_t i=0; i<module_count; ++i)
+    {
+        for(auto & set : modules[i]->descriptor_sets)
+        {
+            for(auto & d : set.descriptors)
+            {
+                if(d.descriptor_type != VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && d.descriptor_type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) continue;
+                const std::string comment = std::string(d.descriptor_type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER ? "Uniform" : "Storage") + " buffer " + d.name + " at set " + std::to_string(set.set) + ", binding " + std::to_string(d.index);
+                writer.declare_struct(get_block_type(d.type), comment.c_str());
+            }
+        }
+        for(auto & p : modules[i]->push_constants) writer.declare_struct(p.type, ("Push constant block " + p.name).c_str());
+    }
+    return writer.str();
+}
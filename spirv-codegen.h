@@ -0,0 +1,16 @@
+#pragma once
+#include "spirv-interface.h"
+#include <initializer_list>
+
+namespace spvi
+{
+    // Generates a self-contained C++ header declaring a struct for every uniform buffer, storage buffer and push constant block of the given modules,
+    // along with the structures nested within them. Each struct reproduces the explicit layout of its block, including the offsets of members,
+    // the strides of arrays and the strides of matrices, by inserting padding where required, so that an instance can be copied into
+    // a buffer with a single memcpy. The layout is checked by static_asserts on the offset of every member and the size of every struct.
+    // Blocks which are shared between modules are only declared once. Vectors are declared as arrays of their components, and matrices as
+    // arrays of their columns, or of their rows if they are row-major. A trailing runtime array is not part of its struct, but its element type is declared. Throws std::logic_error
+    // if a layout cannot be represented, such as members which overlap or types which have no C++ equivalent.
+    std::string generate_cpp_header(const module_info * const * modules, size_t module_count);
+    inline std::string generate_cpp_header(std::initializer_list<const module_info *> modules) { return generate_cpp_header(modules.begin(), modules.size()); }
+}
@@ -1,7 +1,15 @@
 #include "spirv-interface.h"
 #include <vulkan/spirv.hpp11>
 #include <unordered_map>
+#include <unordered_set>
+#include <array>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
 
 ////////////////////////////////////
 // DOM for the SPIR-V file format //
@@ -9,356 +17,2122 @@
 
 namespace
 {
+    enum class part
+    {
+        result_id,   // Used only for the operation which defines a value
+        id,          // (Indexed) Argument to an operation, or the target of a name/decoration
+        optional_id, // 0 or 1 IDs
+        id_list,     // 0 or more IDs
+        num,         // (Indexed) Integral arguments to an operation
+        string,      // A null terminated string
+        word_list,   // Arbitrary-length binary data
+
+        // Single word literal of enum type
+        execution_model, storage_class, dim, access_qualifier, decoration, image_format, function_control,
+
+        // Optional single word literal of enum type
+        opt_access_qualifier,
+    };
+
+    struct part_info 
+    { 
+        part p; int i; 
+        constexpr part_info() : p{part::result_id}, i{0} {}
+        constexpr part_info(part p) : p{p}, i{0} {}
+        constexpr part_info(part p, int i) : p{p}, i{i} {}
+    };
+
+    // The operand layout of a single op code, along with some facts about it which load_module can use without walking the layout
+    struct op_code_info
+    {
+        part_info parts[9];
+        int part_offsets[9];    // Offset of each part from the first word of the instruction, or 0 if the part follows a variable-length operand
+        int part_count;
+        int result_word;        // Offset of the result ID from the first word of the instruction, or 0 if there is no result ID
+        int min_words;          // Word count of an instruction with no optional or variable-length operands
+        int max_words;          // Word count of an instruction with all of its optional operands, or 0 if it has variable-length operands
+        bool has_string;        // Strings must be scanned to validate the length of the instruction
+
+        constexpr op_code_info() : parts{}, part_offsets{}, part_count{0}, result_word{0}, min_words{0}, max_words{0}, has_string{false} {}
+        constexpr op_code_info(std::initializer_list<part_info> layout) : parts{}, part_offsets{}, part_count{0}, result_word{0}, min_words{1}, max_words{1}, has_string{false}
+        {
+            bool variable = false;
+            for(const part_info & p : layout)
+            {
+                if(!variable) part_offsets[part_count] = min_words;
+                if(p.p == part::result_id && !variable) result_word = min_words;
+                switch(p.p)
+                {
+                case part::id_list: case part::word_list: variable = true; break;
+                case part::string: variable = has_string = true; break;
+                case part::optional_id: case part::opt_access_qualifier: ++max_words; break;
+                default: ++min_words; ++max_words; break;
+                }
+                parts[part_count++] = p;
+            }
+            if(variable) max_words = 0;
+        }
+        constexpr bool is_known() const { return part_count != 0; }
+    };
+
+    // Layouts of the op codes which are relevant to reflection, indexed directly by op code. All other op codes have an empty layout.
+    constexpr size_t op_code_count = static_cast<size_t>(spv::Op::OpMemberDecorate) + 1;
+    constexpr std::array<op_code_info, op_code_count> make_op_code_infos()
+    {
+        std::array<op_code_info, op_code_count> infos {};
+        auto set = [&infos](spv::Op op, std::initializer_list<part_info> layout) { infos[static_cast<size_t>(op)] = op_code_info{layout}; };
+        set(spv::Op::OpName, {{part::id,0}, part::string});
+        set(spv::Op::OpMemberName, {{part::id,0}, {part::num,0}, part::string}); // type, member, name
+        set(spv::Op::OpEntryPoint, {part::execution_model, {part::id,0}, part::string, part::id_list}); //id0=function, id_list=interfaces
+        set(spv::Op::OpTypeVoid, {part::result_id});
+        set(spv::Op::OpTypeBool, {part::result_id});
+        set(spv::Op::OpTypeInt, {part::result_id, {part::num,0}, {part::num,1}});
+        set(spv::Op::OpTypeFloat, {part::result_id, {part::num,0}}); // result, width
+        set(spv::Op::OpTypeVector, {part::result_id, {part::id,0}, {part::num,0}});
+        set(spv::Op::OpTypeMatrix, {part::result_id, {part::id,0}, {part::num,0}});
+        set(spv::Op::OpTypeImage, {part::result_id, {part::id,0}, part::dim, {part::num,0}, {part::num,1}, {part::num,2}, {part::num,3}, part::image_format, part::opt_access_qualifier});
+        set(spv::Op::OpTypeSampler, {part::result_id});
+        set(spv::Op::OpTypeSampledImage, {part::result_id, {part::id,0}});
+        set(spv::Op::OpTypeArray, {part::result_id, {part::id,0}, {part::id,1}});
+        set(spv::Op::OpTypeRuntimeArray, {part::result_id, {part::id,0}});
+        set(spv::Op::OpTypeStruct, {part::result_id, part::id_list});
+        set(spv::Op::OpTypeOpaque, {part::result_id, part::string});
+        set(spv::Op::OpTypePointer, {part::result_id, part::storage_class, {part::id,0}});
+        set(spv::Op::OpConstantTrue, {{part::id,0}, part::result_id});
+        set(spv::Op::OpConstantFalse, {{part::id,0}, part::result_id});
+        set(spv::Op::OpConstant, {{part::id,0}, part::result_id, part::word_list});
+        set(spv::Op::OpSpecConstantTrue, {{part::id,0}, part::result_id});
+        set(spv::Op::OpSpecConstantFalse, {{part::id,0}, part::result_id});
+        set(spv::Op::OpSpecConstant, {{part::id,0}, part::result_id, part::word_list});
+        set(spv::Op::OpSpecConstantOp, {{part::id,0}, part::result_id, {part::num,0}, part::id_list}); // num0=op code, id_list=operands
+        set(spv::Op::OpVariable, {{part::id,0}, part::result_id, part::storage_class, part::optional_id});
+        set(spv::Op::OpDecorate, {{part::id,0}, part::decoration, part::word_list});
+        set(spv::Op::OpMemberDecorate, {{part::id,0}, {part::num,0}, part::decoration, part::word_list});
+        return infos;
+    }
+    constexpr std::array<op_code_info, op_code_count> op_code_infos = make_op_code_infos();
+
+    // Returns the layout of an op code, or nullptr if the op code is not relevant to reflection
+    const op_code_info * find_op_code_info(uint32_t op_code) { return op_code < op_code_count && op_code_infos[op_code].is_known() ? &op_code_infos[op_code] : nullptr; }
+
+    const uint32_t none = 0xFFFFFFFF;
+    using errc = spvi::reflection_errc;
+
+    // An error found while loading or converting a module. Errors are returned as values, so that try_reflect_flat can reject invalid modules
+    // without unwinding, and are only thrown as a reflection_exception by the throwing API.
+    struct reflection_failure
+    {
+        errc code;
+        const char * message;   // Always a string literal, so that failures can be reported without allocating
+        const uint32_t * word;  // The instruction at fault, or nullptr if the error is not tied to a single instruction
+
+        explicit operator bool () const { return code != errc::success; }
+    };
+
+    // Thrown in place of Base, so that the throwing API keeps its exception types while try_reflect_flat can still recover the error code
+    template<class Base> struct reflection_exception : Base, reflection_failure
+    {
+        reflection_exception(errc code, const char * message, const uint32_t * word = nullptr) : Base{message}, reflection_failure{code, message, word} {}
+    };
+
+    // Walks the operands of an instruction according to its layout, calling f(part_info, operand_begin, operand_end) for each one.
+    // Walking stops early if f returns true. Otherwise, the instruction is validated to contain exactly the operands its layout describes,
+    // and a failure is returned if it does not.
+    template<class F> reflection_failure walk_parts(const uint32_t * first, const op_code_info & info, F f)
+    {
+        const uint32_t * it = first+1, * const op_code_end = first + (*first >> 16);
+        for(int k=0; k<info.part_count; ++k)
+        {
+            const part_info & p = info.parts[k];
+            const uint32_t * part_end = it+1;
+            switch(p.p)
+            {
+            case part::id_list: case part::word_list: part_end = op_code_end; break;
+            case part::optional_id: case part::opt_access_qualifier: if(it == op_code_end) part_end = it; break;
+            case part::string:
+            {
+                const size_t max_length = (op_code_end - it) * 4, length = strnlen(reinterpret_cast<const char *>(it), max_length);
+                if(length == max_length) return {errc::malformed_instruction, "missing null terminator", first};
+                part_end = it + length/4+1;
+                break;
+            }
+            default: break;
+            }
+            if(part_end > op_code_end) return {errc::malformed_instruction, "incomplete instruction", first};
+            if(f(p, it, part_end)) return {errc::success, nullptr, nullptr};
+            it = part_end;
+        }
+        if(it != op_code_end) return {errc::malformed_instruction, "instruction contains extra data", first};
+        return {errc::success, nullptr, nullptr};
+    }
+
+    // As walk_parts, but throws std::runtime_error if the instruction does not match its layout
+    template<class F> void for_each_part(const uint32_t * first, const op_code_info & info, F f)
+    {
+        if(auto failure = walk_parts(first, info, f)) throw reflection_exception<std::runtime_error>{failure.code, failure.message, failure.word};
+    }
+
+    // A contiguous range of words within a SPIR-V binary
+    struct word_range
+    {
+        const uint32_t * first, * last;
+        const uint32_t * begin() const { return first; }
+        const uint32_t * end() const { return last; }
+        size_t size() const { return last - first; }
+        const uint32_t & operator[] (size_t i) const { return first[i]; }
+    };
+
+    // A view of a single instruction, which refers to the words of the caller's binary rather than copying them.
+    // Apart from the result ID, operands are decoded on demand by walking the layout of the op code.
     struct instruction
     {
         spv::Op                             op_code;
         uint32_t                            result_id;          // The unique ID of the value created by this instruction's single static assignment
-                                                            
-        uint32_t                            ids[4];             // IDs of fixed instruction arguments, should match a result_id from some other instruction
-        std::vector<uint32_t>               var_ids;            // IDs of variadic instruction arguments, should match a result_id from some other instruction
-                                                            
-        uint32_t                            nums[4];            // Literal numeric values
-        std::string                         string;             // Contents of string literal value
-        std::vector<uint32_t>               words;              // Contents of arbitrary-sized literal value
-                                                            
-        spv::ExecutionModel                 execution_model;    // Literal enum value
-        spv::StorageClass                   storage_class;      // Literal enum value
-        spv::Dim                            dim;                // Literal enum value
-        std::optional<spv::AccessQualifier> access_qualifier;   // Literal enum value
-        spv::Decoration                     decoration;         // Literal enum value
-        spv::ImageFormat                    image_format;       // Literal enum value   
-        int                                 function_control;   // Literal bitfield value
+        const uint32_t *                    first;              // The first word of the instruction, which holds its op code and word count
+        const op_code_info *                layout;             // The layout of the instruction's operands
+
+        const uint32_t * find_part(part p, int i=0) const
+        {
+            // Parts at a fixed offset can be found directly, as load_module has already checked that the instruction is long enough to hold them
+            for(int k=0; k<layout->part_count; ++k)
+            {
+                if(layout->parts[k].p != p || layout->parts[k].i != i) continue;
+                const int offset = layout->part_offsets[k];
+                if(offset) return static_cast<uint32_t>(offset) < (*first >> 16) ? first + offset : nullptr;
+                break;
+            }
+
+            // Otherwise the layout must be walked to find where the part begins, which cannot fail as load_module has already walked it
+            const uint32_t * result = nullptr;
+            walk_parts(first, *layout, [&](const part_info & info, const uint32_t * part_begin, const uint32_t * part_end)
+            {
+                if(info.p != p || info.i != i || part_begin == part_end) return false;
+                result = part_begin;
+                return true;
+            });
+            return result;
+        }
+        word_range find_list(part p) const { auto list = find_part(p); return list ? word_range{list, first + (*first >> 16)} : word_range{first, first}; }
+
+        uint32_t                            id(int i) const                 { auto w = find_part(part::id, i); return w ? *w : none; }  // IDs of fixed instruction arguments, should match a result_id from some other instruction
+        word_range                          var_ids() const                 { auto list = find_list(part::id_list); return list.size() ? list : find_list(part::optional_id); } // IDs of variadic instruction arguments
+        uint32_t                            num(int i) const                { auto w = find_part(part::num, i); return w ? *w : 0; }    // Literal numeric values
+        const char *                        string() const                  { auto w = find_part(part::string); return w ? reinterpret_cast<const char *>(w) : ""; } // Contents of string literal value, null terminator is validated by load_module
+        word_range                          words() const                   { return find_list(part::word_list); } // Contents of arbitrary-sized literal value
+
+        spv::ExecutionModel                 execution_model() const         { return static_cast<spv::ExecutionModel>(*find_part(part::execution_model)); }
+        spv::StorageClass                   storage_class() const           { return static_cast<spv::StorageClass>(*find_part(part::storage_class)); }
+        spv::Dim                            dim() const                     { return static_cast<spv::Dim>(*find_part(part::dim)); }
+        spv::Decoration                     decoration() const              { return static_cast<spv::Decoration>(*find_part(part::decoration)); }
+        spv::ImageFormat                    image_format() const            { return static_cast<spv::ImageFormat>(*find_part(part::image_format)); }
+        std::optional<spv::AccessQualifier> access_qualifier() const        { auto w = find_part(part::opt_access_qualifier); return w ? std::optional<spv::AccessQualifier>{static_cast<spv::AccessQualifier>(*w)} : std::nullopt; }
+    };
+
+    // Counts calls on the hot paths of reflection when the library is built with SPVI_COUNT_LOOKUPS defined as 1, and otherwise compiles to nothing
+    struct lookup_counter
+    {
+#if SPVI_COUNT_LOOKUPS
+        mutable uint64_t count = 0;
+        void add() const { ++count; }
+#else
+        static constexpr uint64_t count = 0;
+        void add() const {}
+#endif
+    };
+
+    // Groups the indices of instructions by some integer key, storing the members of each group contiguously
+    struct instruction_table
+    {
+        std::vector<uint32_t> offsets;  // The instructions for key k are stored in entries[offsets[k]] through entries[offsets[k+1]-1]
+        std::vector<uint32_t> entries;  // Indices into module::instructions
+
+        // get_key should return the key for a given instruction, or a value >= key_count if it does not belong in the table
+        template<class F> void build(const std::vector<instruction> & instructions, size_t key_count, F get_key)
+        {
+            offsets.assign(key_count+1, 0);
+            for(auto & i : instructions) { const size_t key = get_key(i); if(key < key_count) ++offsets[key+1]; }
+            for(size_t k=0; k<key_count; ++k) offsets[k+1] += offsets[k];
+            entries.resize(offsets[key_count]);
+            for(size_t i=0; i<instructions.size(); ++i) { const size_t key = get_key(instructions[i]); if(key < key_count) entries[offsets[key]++] = static_cast<uint32_t>(i); }
+            for(size_t k=key_count; k>0; --k) offsets[k] = offsets[k-1];
+            offsets[0] = 0;
+        }
+
+        size_t get_capacity_bytes() const { return (offsets.capacity() + entries.capacity()) * sizeof(uint32_t); }
+        bool contains(size_t key) const { return !offsets.empty() && key < offsets.size()-1; }
+        const uint32_t * begin(size_t key) const { return contains(key) ? entries.data() + offsets[key] : nullptr; }
+        const uint32_t * end(size_t key) const { return contains(key) ? entries.data() + offsets[key+1] : nullptr; }
     };
 
     struct module
     {
-        uint32_t version_number, generator_id, schema_id;
+        uint32_t version_number, generator_id, id_bound, schema_id;
         std::vector<instruction> instructions;
+        size_t declarations_end;                // Offset of the first word which was not scanned, as load_module stops at the first function definition
+
+        // Dense tables indexed by ID, built by load_module so that all of the lookups below are O(1)
+        std::vector<uint32_t> definitions;      // Index of the instruction whose result_id is a given ID, or none
+        std::vector<uint32_t> names;            // Index of the OpName targeting a given ID, or none
+        std::vector<uint32_t> member_bases;     // For each struct type ID, the index of its first member within member_names and member_decorations
+        std::vector<uint32_t> member_names;     // Index of the OpMemberName targeting a given struct member, or none
+        instruction_table decorations;          // OpDecorate instructions, keyed by target ID
+        instruction_table member_decorations;   // OpMemberDecorate instructions, keyed by index within member_names
+        lookup_counter id_lookups, name_lookups, decoration_lookups;
+
+        size_t get_capacity_bytes() const
+        {
+            return instructions.capacity() * sizeof(instruction) + (definitions.capacity() + names.capacity() + member_bases.capacity() + member_names.capacity()) * sizeof(uint32_t)
+                + decorations.get_capacity_bytes() + member_decorations.get_capacity_bytes();
+        }
+
+        size_t get_member_slot(uint32_t result_id, size_t index) const
+        {
+            if(result_id >= member_bases.size() || member_bases[result_id] == none) return none;
+            if(index >= instructions[definitions[result_id]].var_ids().size()) return none;
+            return member_bases[result_id] + index;
+        }
 
-        const instruction & get_instruction(uint32_t result_id) const 
+        reflection_failure get_instruction(uint32_t result_id, const instruction * & inst) const
         { 
-            for(auto & i : instructions) if(i.result_id == result_id) return i; 
-            throw std::logic_error("bad id"); 
+            id_lookups.add();
+            if(result_id < definitions.size() && definitions[result_id] != none) { inst = &instructions[definitions[result_id]]; return {errc::success, nullptr, nullptr}; }
+            return {errc::invalid_id, "bad id", nullptr};
+        }
+
+        const char * find_name(uint32_t result_id) const
+        {
+            name_lookups.add();
+            return result_id < names.size() && names[result_id] != none ? instructions[names[result_id]].string() : nullptr;
         }
 
+        // Debug names are optional, and are removed from stripped binaries, so a missing name is reported as an empty string rather than an error
         const char * get_name(uint32_t result_id) const 
         { 
-            for(auto & i : instructions) if(i.op_code == spv::Op::OpName && i.ids[0] == result_id) return i.string.c_str(); 
-            throw std::logic_error("no name");
+            auto name = find_name(result_id);
+            return name ? name : "";
         }
 
         const char * get_member_name(uint32_t result_id, size_t index) const
         {
-            for(auto & i : instructions) if(i.op_code == spv::Op::OpMemberName && i.ids[0] == result_id && i.nums[0] == index) return i.string.c_str(); 
-            throw std::logic_error("no name");
+            name_lookups.add();
+            const size_t slot = get_member_slot(result_id, index);
+            return slot != none && member_names[slot] != none ? instructions[member_names[slot]].string() : "";
         }
 
-        bool get_decoration(uint32_t result_id, spv::Decoration decoration, size_t size, void * data) const
+        // Reads the literal of a decoration which has exactly one, which build_tables has checked
+        bool get_decoration(uint32_t result_id, spv::Decoration decoration, uint32_t & value) const
         {
-            for(auto & i : instructions) 
+            decoration_lookups.add();
+            for(auto it = decorations.begin(result_id), end = decorations.end(result_id); it != end; ++it)
             {
-                if(i.op_code == spv::Op::OpDecorate && i.ids[0] == result_id && i.decoration == decoration)
+                auto & i = instructions[*it];
+                if(i.decoration() == decoration)
                 {
-                    if(size != i.words.size()*4) throw std::logic_error("insufficient decoration data");
-                    memcpy(data, i.words.data(), size);
+                    value = i.words()[0];
                     return true;
                 }
             }
             return false;
         }
 
-        bool get_member_decoration(uint32_t result_id, size_t index, spv::Decoration decoration, size_t size, void * data) const
+        bool has_decoration(uint32_t result_id, spv::Decoration decoration) const
+        {
+            decoration_lookups.add();
+            for(auto it = decorations.begin(result_id), end = decorations.end(result_id); it != end; ++it) if(instructions[*it].decoration() == decoration) return true;
+            return false;
+        }
+
+        bool has_member_decoration(uint32_t result_id, size_t index, spv::Decoration decoration) const
+        {
+            decoration_lookups.add();
+            const size_t slot = get_member_slot(result_id, index);
+            for(auto it = member_decorations.begin(slot), end = member_decorations.end(slot); it != end; ++it) if(instructions[*it].decoration() == decoration) return true;
+            return false;
+        }
+
+        bool get_member_decoration(uint32_t result_id, size_t index, spv::Decoration decoration, uint32_t & value) const
         {
-            for(auto & i : instructions) 
+            decoration_lookups.add();
+            const size_t slot = get_member_slot(result_id, index);
+            for(auto it = member_decorations.begin(slot), end = member_decorations.end(slot); it != end; ++it)
             {
-                if(i.op_code == spv::Op::OpMemberDecorate && i.ids[0] == result_id && i.nums[0] == index && i.decoration == decoration)
+                auto & i = instructions[*it];
+                if(i.decoration() == decoration)
                 {
-                    if(size != i.words.size()*4) throw std::logic_error("insufficient decoration data");
-                    memcpy(data, i.words.data(), size);
+                    value = i.words()[0];
                     return true;
                 }
             }
             return false;
         }
-    };
 
-    enum class part
-    {
-        result_id,   // Used only for the operation which defines a value
-        id,          // (Indexed) Argument to an operation, or the target of a name/decoration
-        optional_id, // 0 or 1 IDs
-        id_list,     // 0 or more IDs
-        num,         // (Indexed) Integral arguments to an operation
-        string,      // A null terminated string
-        word_list,   // Arbitrary-length binary data
+        static bool has_single_literal(spv::Decoration decoration)
+        {
+            switch(decoration)
+            {
+            case spv::Decoration::SpecId: case spv::Decoration::ArrayStride: case spv::Decoration::MatrixStride: case spv::Decoration::Location:
+            case spv::Decoration::Binding: case spv::Decoration::DescriptorSet: case spv::Decoration::Offset: return true;
+            default: return false;
+            }
+        }
 
-        // Single word literal of enum type
-        execution_model, storage_class, dim, access_qualifier, decoration, image_format, function_control,
+        reflection_failure build_tables()
+        {
+            // Every ID must be less than the bound from the header, but the tables only need to cover the IDs actually referenced
+            size_t id_count = 0;
+            auto check_id = [&](uint32_t id) { id_count = std::max<size_t>(id_count, id+size_t(1)); return id < id_bound; };
+            for(auto & i : instructions)
+            {
+                if(i.result_id != none && !check_id(i.result_id)) return {errc::invalid_id, "id out of bounds", i.first};
+                if(i.op_code == spv::Op::OpName || i.op_code == spv::Op::OpMemberName || i.op_code == spv::Op::OpDecorate || i.op_code == spv::Op::OpMemberDecorate)
+                {
+                    if(!check_id(i.id(0))) return {errc::invalid_id, "id out of bounds", i.first};
+                }
 
-        // Optional single word literal of enum type
-        opt_access_qualifier,
-    };
+                // The decorations which reflection reads a literal from are checked here, so that reading them during conversion cannot fail
+                if((i.op_code == spv::Op::OpDecorate || i.op_code == spv::Op::OpMemberDecorate) && has_single_literal(i.decoration()) && i.words().size() != 1)
+                {
+                    return {errc::invalid_module, "insufficient decoration data", i.first};
+                }
+            }
 
-    struct part_info 
-    { 
-        part p; int i; 
-        part_info(part p) : p{p}, i{0} {}
-        part_info(part p, int i) : p{p}, i{i} {}
+            definitions.assign(id_count, none);
+            names.assign(id_count, none);
+            member_bases.assign(id_count, none);
+            size_t member_count = 0;
+            for(size_t index=0; index<instructions.size(); ++index)
+            {
+                auto & i = instructions[index];
+                if(i.result_id != none) definitions[i.result_id] = static_cast<uint32_t>(index);
+                if(i.op_code == spv::Op::OpName) names[i.id(0)] = static_cast<uint32_t>(index);
+                if(i.op_code == spv::Op::OpTypeStruct && i.result_id != none)
+                {
+                    member_bases[i.result_id] = static_cast<uint32_t>(member_count);
+                    member_count += i.var_ids().size();
+                }
+            }
+
+            member_names.assign(member_count, none);
+            for(size_t index=0; index<instructions.size(); ++index)
+            {
+                auto & i = instructions[index];
+                if(i.op_code != spv::Op::OpMemberName) continue;
+                const size_t slot = get_member_slot(i.id(0), i.num(0));
+                if(slot != none) member_names[slot] = static_cast<uint32_t>(index);
+            }
+
+            decorations.build(instructions, id_count, [](const instruction & i) -> size_t { return i.op_code == spv::Op::OpDecorate ? i.id(0) : none; });
+            member_decorations.build(instructions, member_count, [this](const instruction & i) -> size_t { return i.op_code == spv::Op::OpMemberDecorate ? get_member_slot(i.id(0), i.num(0)) : none; });
+            return {errc::success, nullptr, nullptr};
+        }
     };
-    const std::unordered_map<spv::Op, std::vector<part_info>> op_code_infos
-    {
-        {spv::Op::OpName, {{part::id,0}, part::string}},
-        {spv::Op::OpMemberName, {{part::id,0}, {part::num,0}, part::string}}, // type, member, name
-        {spv::Op::OpEntryPoint, {part::execution_model, {part::id,0}, part::string, part::id_list}}, //id0=function, id_list=interfaces
-        {spv::Op::OpTypeVoid, {part::result_id}},
-        {spv::Op::OpTypeBool, {part::result_id}},
-        {spv::Op::OpTypeInt, {part::result_id, {part::num,0}, {part::num,1}}},
-        {spv::Op::OpTypeFloat, {part::result_id, {part::num,0}}}, // result, width
-        {spv::Op::OpTypeVector, {part::result_id, {part::id,0}, {part::num,0}}}, 
-        {spv::Op::OpTypeMatrix, {part::result_id, {part::id,0}, {part::num,0}}},
-        {spv::Op::OpTypeImage, {part::result_id, {part::id,0}, part::dim, {part::num,0}, {part::num,1}, {part::num,2}, {part::num,3}, part::image_format, part::opt_access_qualifier}},
-        {spv::Op::OpTypeSampler, {part::result_id}},
-        {spv::Op::OpTypeSampledImage, {part::result_id, {part::id,0}}},
-        {spv::Op::OpTypeArray, {part::result_id, {part::id,0}, {part::id,1}}},
-        {spv::Op::OpTypeRuntimeArray, {part::result_id, {part::id,0}}},
-        {spv::Op::OpTypeStruct, {part::result_id, part::id_list}},
-        {spv::Op::OpTypeOpaque, {part::result_id, part::string}},
-        {spv::Op::OpTypePointer, {part::result_id, part::storage_class, {part::id,0}}},
-        {spv::Op::OpConstant, {{part::id,0}, part::result_id, part::word_list}},
-        {spv::Op::OpVariable, {{part::id,0}, part::result_id, part::storage_class, part::optional_id}},
-        {spv::Op::OpDecorate, {{part::id,0}, part::decoration, part::word_list}},
-        {spv::Op::OpMemberDecorate, {{part::id,0}, {part::num,0}, part::decoration, part::word_list}},
+
+    // Controls how much of a binary is walked by load_module
+    enum class load_mode
+    {
+        whole_module,       // Walk and validate every instruction, including function bodies
+        declarations_only,  // Stop at the first OpFunction, as everything needed for reflection is declared before it
     };
 
-    module load_module(const uint32_t * words, size_t word_count)
+    // One bit per op code which has a layout in op_code_infos, so that classifying an instruction while scanning costs a single bit test
+    constexpr std::array<uint64_t, 2> make_op_code_mask()
     {
-        if(word_count < 5) throw std::runtime_error("not SPIR-V");
-        if(words[0] != 0x07230203) throw std::runtime_error("not SPIR-V");    
+        static_assert(op_code_count <= 128, "op code mask is too small");
+        std::array<uint64_t, 2> mask {};
+        for(size_t i=0; i<op_code_count; ++i) if(op_code_infos[i].is_known()) mask[i/64] |= uint64_t(1) << i%64;
+        return mask;
+    }
+    constexpr std::array<uint64_t, 2> op_code_mask = make_op_code_mask();
+
+    // Walks the instruction lengths of a binary, appending the offset of every instruction with a known layout to offsets, and storing the offset at which
+    // the walk stopped. This pass does nothing but follow the chain of lengths, as each instruction can only be found once the length of the previous one is known,
+    // so the offset is stored unconditionally and only kept if the op code is relevant, rather than branching on a mix of op codes which is hard to predict.
+    reflection_failure scan_instructions(const uint32_t * words, size_t word_count, load_mode mode, std::vector<uint32_t> & offsets, size_t & stop_offset)
+    {
+        if(word_count < 5) return {errc::not_spirv, "not SPIR-V", nullptr};
+        if(words[0] != 0x07230203) return {errc::not_spirv, "not SPIR-V", words};
+        if(word_count > UINT32_MAX) return {errc::unsupported, "binary is too large", nullptr};
+
+        const uint32_t end = static_cast<uint32_t>(word_count);
+        uint32_t offset = 5;
+        size_t count = offsets.size();
+        offsets.resize(count + 256);
+        while(offset != end)
+        {
+            const uint32_t word = words[offset], op_code = word & spv::OpCodeMask, length = word >> 16;
+            if(length == 0) return {errc::malformed_instruction, "invalid opcode length", words + offset};
+            if(length > end - offset) return {errc::malformed_instruction, "incomplete opcode", words + offset};
+
+            // The logical layout requires that all entry points, debug names, annotations, types, constants and global variables precede function definitions
+            if(mode == load_mode::declarations_only && op_code == static_cast<uint32_t>(spv::Op::OpFunction)) break;
+
+            if(count == offsets.size()) offsets.resize(count * 2);
+            offsets[count] = offset;
+            count += op_code < 128 && op_code_mask[op_code / 64] >> op_code % 64 & 1;
+            offset += length;
+        }
+        offsets.resize(count);
+        stop_offset = offset;
+        return {errc::success, nullptr, nullptr};
+    }
+
+    // Loads a module without throwing on malformed input, which is only possible because names and decorations are indexed
+    // before any operand is decoded. Failures leave the module partially loaded.
+    reflection_failure load_module(const uint32_t * words, size_t word_count, load_mode mode, module & m)
+    {
+        std::vector<uint32_t> offsets;
+        size_t stop_offset;
+        if(auto failure = scan_instructions(words, word_count, mode, offsets, stop_offset)) return failure;
+        m.declarations_end = stop_offset;
 
-        module m;
         m.version_number = words[1];
         m.generator_id = words[2];
+        m.id_bound = words[3];
         m.schema_id = words[4];
 
-        const uint32_t * it = words + 5, * binary_end = words + word_count;
-        while(it != binary_end)
+        // Only instructions which are relevant to reflection are retained, and no operands are copied out of the binary
+        m.instructions.reserve(offsets.size());
+        for(const uint32_t offset : offsets)
         {
-            instruction inst {};
-            inst.op_code = static_cast<spv::Op>(*it & spv::OpCodeMask);
-            inst.result_id = 0xFFFFFFFF;
-            for(auto & id : inst.ids) id = 0xFFFFFFFF;
+            const uint32_t * it = words + offset, op_code_length = *it >> 16;
+            const op_code_info * info = &op_code_infos[*it & spv::OpCodeMask];
 
-            const uint32_t op_code_length = *it >> 16;
-            const uint32_t * op_code_end = it + op_code_length;
-            if(op_code_end > binary_end) throw std::runtime_error("incomplete opcode");
+            // Only layouts with strings need to be walked to validate the word count, all others can be checked against their bounds
+            if(info->has_string) { if(auto failure = walk_parts(it, *info, [](const part_info &, const uint32_t *, const uint32_t *) { return false; })) return failure; }
+            else if(op_code_length < static_cast<uint32_t>(info->min_words)) return {errc::malformed_instruction, "incomplete instruction", it};
+            else if(info->max_words && op_code_length > static_cast<uint32_t>(info->max_words)) return {errc::malformed_instruction, "instruction contains extra data", it};
 
-            auto it_info = op_code_infos.find(inst.op_code);
-            if(it_info != op_code_infos.end())
-            {
-                ++it;
-                for(const part_info & p : it_info->second) switch(p.p)
-                {
-                default:                            throw std::logic_error("unsupported instruction part");
-                case part::result_id:               inst.result_id = *it++; break;
-                case part::id:                      inst.ids[p.i] = *it++; break;
-                case part::id_list:                 while(it != op_code_end) inst.var_ids.push_back(*it++); break;
-                case part::optional_id:             if(it != op_code_end) inst.var_ids.push_back(*it++); break;
-                case part::num:                     inst.nums[p.i] = *it++; break;
-                case part::word_list:               while(it != op_code_end) inst.words.push_back(*it++); break;
-                case part::dim:                     inst.dim = static_cast<spv::Dim>(*it++); break;
-                case part::storage_class:           inst.storage_class = static_cast<spv::StorageClass>(*it++); break;
-                case part::decoration:              inst.decoration = static_cast<spv::Decoration>(*it++); break;
-                case part::execution_model:         inst.execution_model = static_cast<spv::ExecutionModel>(*it++); break;
-                case part::image_format:            inst.image_format = static_cast<spv::ImageFormat>(*it++); break;
-                case part::access_qualifier:        inst.access_qualifier = static_cast<spv::AccessQualifier>(*it++); break;
-                case part::opt_access_qualifier:    if(it != op_code_end) inst.access_qualifier = static_cast<spv::AccessQualifier>(*it++); break;
-                case part::function_control:        inst.function_control = static_cast<int>(*it++); break;
-                case part::string:
-                    const char * s = reinterpret_cast<const char *>(it);
-                    const size_t max_length = (op_code_end - it) * 4, length = strnlen(s, max_length);
-                    if(length == max_length) throw std::runtime_error("missing null terminator");
-                    inst.string.assign(s, s+length);
-                    it += length/4+1;
-                    break;
-                }
-                if(it != op_code_end) throw std::logic_error("instruction contains extra data");
-            }
-            m.instructions.push_back(inst);
-            it = op_code_end;
+            // Result IDs are checked here rather than in build_tables, as an ID equal to the none sentinel would otherwise be mistaken for no result
+            if(info->result_word && it[info->result_word] >= m.id_bound) return {errc::invalid_id, "id out of bounds", it};
+            m.instructions.push_back({static_cast<spv::Op>(*it & spv::OpCodeMask), info->result_word ? it[info->result_word] : none, it, info});
         }
 
+        return m.build_tables();
+    }
+
+    module load_module(const uint32_t * words, size_t word_count, load_mode mode)
+    {
+        module m;
+        if(auto failure = load_module(words, word_count, mode, m)) throw reflection_exception<std::runtime_error>{failure.code, failure.message, failure.word};
         return m;
     }
 }
 
+const char * spvi::get_op_code_name(uint32_t op_code)
+{
+    switch(static_cast<spv::Op>(op_code))
+    {
+    case spv::Op::OpName: return "OpName";
+    case spv::Op::OpMemberName: return "OpMemberName";
+    case spv::Op::OpEntryPoint: return "OpEntryPoint";
+    case spv::Op::OpTypeVoid: return "OpTypeVoid";
+    case spv::Op::OpTypeBool: return "OpTypeBool";
+    case spv::Op::OpTypeInt: return "OpTypeInt";
+    case spv::Op::OpTypeFloat: return "OpTypeFloat";
+    case spv::Op::OpTypeVector: return "OpTypeVector";
+    case spv::Op::OpTypeMatrix: return "OpTypeMatrix";
+    case spv::Op::OpTypeImage: return "OpTypeImage";
+    case spv::Op::OpTypeSampler: return "OpTypeSampler";
+    case spv::Op::OpTypeSampledImage: return "OpTypeSampledImage";
+    case spv::Op::OpTypeArray: return "OpTypeArray";
+    case spv::Op::OpTypeRuntimeArray: return "OpTypeRuntimeArray";
+    case spv::Op::OpTypeStruct: return "OpTypeStruct";
+    case spv::Op::OpTypeOpaque: return "OpTypeOpaque";
+    case spv::Op::OpTypePointer: return "OpTypePointer";
+    case spv::Op::OpConstantTrue: return "OpConstantTrue";
+    case spv::Op::OpConstantFalse: return "OpConstantFalse";
+    case spv::Op::OpConstant: return "OpConstant";
+    case spv::Op::OpSpecConstantTrue: return "OpSpecConstantTrue";
+    case spv::Op::OpSpecConstantFalse: return "OpSpecConstantFalse";
+    case spv::Op::OpSpecConstant: return "OpSpecConstant";
+    case spv::Op::OpSpecConstantOp: return "OpSpecConstantOp";
+    case spv::Op::OpVariable: return "OpVariable";
+    case spv::Op::OpDecorate: return "OpDecorate";
+    case spv::Op::OpMemberDecorate: return "OpMemberDecorate";
+    default: return nullptr;
+    }
+}
+
+spvi::instruction_index spvi::index_instructions(const uint32_t * words, size_t word_count)
+{
+    instruction_index index;
+    if(auto failure = scan_instructions(words, word_count, load_mode::declarations_only, index.offsets, index.declarations_end)) throw reflection_exception<std::runtime_error>{failure.code, failure.message, failure.word};
+    return index;
+}
+
 //////////////
 // Analysis //
 //////////////
 
-static spvi::type::numeric convert_numeric_type(const module & mod, const instruction & inst, uint32_t matrix_stride)
+// Matrices in a block are laid out according to the MatrixStride and RowMajor decorations of the member they are stored in, where the stride
+// is the distance between columns of a column-major matrix, and between rows of a row-major matrix
+static reflection_failure convert_numeric_type(const module & mod, const instruction & inst, uint32_t matrix_stride, bool row_major, spvi::type::numeric & numeric)
 {
-    spvi::type::numeric element_type;
+    const instruction * component;
     switch(inst.op_code)
     {
-    case spv::Op::OpTypeFloat: return {spvi::type::float_, inst.nums[0], 1, 1, 0, 0};
-    case spv::Op::OpTypeInt: return {inst.nums[1] ? spvi::type::int_ : spvi::type::uint_, inst.nums[0], 1, 1};
+    case spv::Op::OpTypeFloat: numeric = {spvi::type::float_, inst.num(0), 1, 1, 0, 0}; return {errc::success, nullptr, nullptr};
+    case spv::Op::OpTypeInt: numeric = {inst.num(1) ? spvi::type::int_ : spvi::type::uint_, inst.num(0), 1, 1}; return {errc::success, nullptr, nullptr};
     case spv::Op::OpTypeVector: 
-        element_type = convert_numeric_type(mod, mod.get_instruction(inst.ids[0]), matrix_stride);
-        element_type.row_count = inst.nums[0];
-        element_type.row_stride = element_type.elem_width/8;
-        return element_type;
+        if(auto failure = mod.get_instruction(inst.id(0), component)) return failure;
+        if(component->op_code != spv::Op::OpTypeFloat && component->op_code != spv::Op::OpTypeInt) return {errc::invalid_module, "wrong type", inst.first};
+        if(auto failure = convert_numeric_type(mod, *component, matrix_stride, row_major, numeric)) return failure;
+        numeric.row_count = inst.num(0);
+        numeric.row_stride = numeric.elem_width/8;
+        return {errc::success, nullptr, nullptr};
     case spv::Op::OpTypeMatrix: 
-        element_type = convert_numeric_type(mod, mod.get_instruction(inst.ids[0]), matrix_stride);
-        element_type.column_count = inst.nums[0];
-        element_type.column_stride = matrix_stride;
-        return element_type;
-    default: throw std::logic_error("wrong type");
+        if(auto failure = mod.get_instruction(inst.id(0), component)) return failure;
+        if(component->op_code != spv::Op::OpTypeVector) return {errc::invalid_module, "wrong type", inst.first};
+        if(auto failure = convert_numeric_type(mod, *component, matrix_stride, row_major, numeric)) return failure;
+        numeric.column_count = inst.num(0);
+        if(row_major)
+        {
+            numeric.column_stride = numeric.row_stride;
+            numeric.row_stride = matrix_stride;
+        }
+        else numeric.column_stride = matrix_stride;
+        return {errc::success, nullptr, nullptr};
+    default: return {errc::invalid_module, "wrong type", inst.first};
     }
 }
 
-static size_t decode_array_length(const module & mod, const instruction & inst)
+// Decodes the bits of an integer or floating point constant, zero extended to 64 bits
+static reflection_failure decode_constant_bits(const module & mod, const instruction & inst, uint64_t & bits)
+{
+    const instruction * type;
+    if(auto failure = mod.get_instruction(inst.id(0), type)) return failure;
+    if(type->op_code != spv::Op::OpTypeInt && type->op_code != spv::Op::OpTypeFloat) return {errc::invalid_module, "constant is not a number", inst.first};
+    if(type->num(0) > 64) return {errc::unsupported, "unsupported width", inst.first};
+    const auto words = inst.words();
+    if(words.size() != (type->num(0)+31)/32) return {errc::invalid_module, "constant does not match width of type", inst.first};
+    bits = words.size() == 2 ? uint64_t(words[1]) << 32 | words[0] : words[0];
+    if(type->num(0) < 64) bits &= (uint64_t(1) << type->num(0)) - 1;
+    return {errc::success, nullptr, nullptr};
+}
+
+// Returns VK_FORMAT_MAX_ENUM for formats which have no Vulkan equivalent
+static VkFormat convert_image_format(spv::ImageFormat format)
 {
-    if(inst.op_code != spv::Op::OpConstant) throw std::logic_error("array length not a constant value");
-    auto type = mod.get_instruction(inst.ids[0]);
-    if(type.op_code != spv::Op::OpTypeInt) throw std::logic_error("array length not an integer constant");
-    if(type.nums[1]) // signed
+    switch(format)
     {
-        switch(type.nums[0]) // width
-        {
-        case 32: return static_cast<size_t>(reinterpret_cast<const int32_t &>(inst.words[0]));
-        case 64: return static_cast<size_t>(reinterpret_cast<const int64_t &>(inst.words[0]));
-        default: throw std::logic_error("unsupported width");
-        }
+    case spv::ImageFormat::Unknown: return VK_FORMAT_UNDEFINED;
+    case spv::ImageFormat::Rgba32f: return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case spv::ImageFormat::Rgba16f: return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case spv::ImageFormat::R32f: return VK_FORMAT_R32_SFLOAT;
+    case spv::ImageFormat::Rgba8: return VK_FORMAT_R8G8B8A8_UNORM;
+    case spv::ImageFormat::Rgba8Snorm: return VK_FORMAT_R8G8B8A8_SNORM;
+    case spv::ImageFormat::Rg32f: return VK_FORMAT_R32G32_SFLOAT;
+    case spv::ImageFormat::Rg16f: return VK_FORMAT_R16G16_SFLOAT;
+    case spv::ImageFormat::R11fG11fB10f: return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+    case spv::ImageFormat::R16f: return VK_FORMAT_R16_SFLOAT;
+    case spv::ImageFormat::Rgba16: return VK_FORMAT_R16G16B16A16_UNORM;
+    case spv::ImageFormat::Rgb10A2: return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+    case spv::ImageFormat::Rg16: return VK_FORMAT_R16G16_UNORM;
+    case spv::ImageFormat::Rg8: return VK_FORMAT_R8G8_UNORM;
+    case spv::ImageFormat::R16: return VK_FORMAT_R16_UNORM;
+    case spv::ImageFormat::R8: return VK_FORMAT_R8_UNORM;
+    case spv::ImageFormat::Rgba16Snorm: return VK_FORMAT_R16G16B16A16_SNORM;
+    case spv::ImageFormat::Rg16Snorm: return VK_FORMAT_R16G16_SNORM;
+    case spv::ImageFormat::Rg8Snorm: return VK_FORMAT_R8G8_SNORM;
+    case spv::ImageFormat::R16Snorm: return VK_FORMAT_R16_SNORM;
+    case spv::ImageFormat::R8Snorm: return VK_FORMAT_R8_SNORM;
+    case spv::ImageFormat::Rgba32i: return VK_FORMAT_R32G32B32A32_SINT;
+    case spv::ImageFormat::Rgba16i: return VK_FORMAT_R16G16B16A16_SINT;
+    case spv::ImageFormat::Rgba8i: return VK_FORMAT_R8G8B8A8_SINT;
+    case spv::ImageFormat::R32i: return VK_FORMAT_R32_SINT;
+    case spv::ImageFormat::Rg32i: return VK_FORMAT_R32G32_SINT;
+    case spv::ImageFormat::Rg16i: return VK_FORMAT_R16G16_SINT;
+    case spv::ImageFormat::Rg8i: return VK_FORMAT_R8G8_SINT;
+    case spv::ImageFormat::R16i: return VK_FORMAT_R16_SINT;
+    case spv::ImageFormat::R8i: return VK_FORMAT_R8_SINT;
+    case spv::ImageFormat::Rgba32ui: return VK_FORMAT_R32G32B32A32_UINT;
+    case spv::ImageFormat::Rgba16ui: return VK_FORMAT_R16G16B16A16_UINT;
+    case spv::ImageFormat::Rgba8ui: return VK_FORMAT_R8G8B8A8_UINT;
+    case spv::ImageFormat::R32ui: return VK_FORMAT_R32_UINT;
+    case spv::ImageFormat::Rgb10a2ui: return VK_FORMAT_A2B10G10R10_UINT_PACK32;
+    case spv::ImageFormat::Rg32ui: return VK_FORMAT_R32G32_UINT;
+    case spv::ImageFormat::Rg16ui: return VK_FORMAT_R16G16_UINT;
+    case spv::ImageFormat::Rg8ui: return VK_FORMAT_R8G8_UINT;
+    case spv::ImageFormat::R16ui: return VK_FORMAT_R16_UINT;
+    case spv::ImageFormat::R8ui: return VK_FORMAT_R8_UINT;
+    default: return VK_FORMAT_MAX_ENUM;
     }
-    else // unsigned
+}
+
+static reflection_failure convert_image_type(const module & mod, const instruction & image_inst, spvi::type::image & i)
+{
+    if(image_inst.op_code != spv::Op::OpTypeImage) return {errc::invalid_module, "not an image type", image_inst.first};
+
+    i = {};
+    const instruction * channel_inst;
+    spvi::type::numeric channel;
+    if(auto failure = mod.get_instruction(image_inst.id(0), channel_inst)) return failure;
+    if(auto failure = convert_numeric_type(mod, *channel_inst, 0, false, channel)) return failure;
+    i.channel_kind = channel.elem_kind;
+    const bool is_array = image_inst.num(1) == 1;
+    switch(image_inst.dim())
     {
-        switch(type.nums[0]) // width
-        {
-        case 32: return static_cast<size_t>(reinterpret_cast<const uint32_t &>(inst.words[0]));
-        case 64: return static_cast<size_t>(reinterpret_cast<const uint64_t &>(inst.words[0]));
-        default: throw std::logic_error("unsupported width");
-        }
+    case spv::Dim::Dim1D: i.view_type = is_array ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D; break;
+    case spv::Dim::Dim2D: i.view_type = is_array ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D; break;
+    case spv::Dim::Dim3D: i.view_type = VK_IMAGE_VIEW_TYPE_3D; break;
+    case spv::Dim::Cube: i.view_type = is_array ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE; break;
+    default: return {errc::unsupported, "unsupported image Dim", image_inst.first};
     }
+    if(image_inst.num(2) == 1) i.is_multisampled = true;
+    if(image_inst.num(0) == 1) i.is_shadow = true;
+    if(image_inst.num(3) == 2) i.is_storage = true;
+    i.format = convert_image_format(image_inst.image_format());
+    if(i.format == VK_FORMAT_MAX_ENUM) return {errc::unsupported, "unsupported image format", image_inst.first};
+    return {errc::success, nullptr, nullptr};
+}
+
+static reflection_failure convert_sampler_type(const module & mod, const instruction & inst, spvi::type::sampler & s)
+{
+    const instruction * image_inst;
+    spvi::type::image i;
+    if(auto failure = mod.get_instruction(inst.id(0), image_inst)) return failure;
+    if(auto failure = convert_image_type(mod, *image_inst, i)) return failure;
+    s = {i.channel_kind, i.view_type, i.is_multisampled, i.is_shadow};
+    return {errc::success, nullptr, nullptr};
 }
 
-static spvi::type convert_type(const module & mod, const instruction & inst, uint32_t matrix_stride)
+namespace
 {
-    if(inst.op_code == spv::Op::OpTypeStruct)
+    typedef spvi::specialization_op spec_op;
+
+    uint64_t truncate_bits(uint64_t value, uint32_t width) { return width < 64 ? value & ((uint64_t(1) << width) - 1) : value; }
+    int64_t sign_extend(uint64_t value, uint32_t width) { return static_cast<int64_t>(width < 64 && (value >> (width-1) & 1) ? value | ~((uint64_t(1) << width) - 1) : value); }
+
+    int get_operand_count(spec_op::code op)
     {
-        spvi::type::structure r {mod.get_name(inst.result_id)};
-        for(size_t i=0; i<inst.var_ids.size(); ++i)
+        switch(op)
         {
-            // Note: Input/output structs might not have a physical layout, so Offset may not always be present
-            std::optional<size_t> opt_offset; uint32_t offset;
-            if(mod.get_member_decoration(inst.result_id, i, spv::Decoration::Offset, sizeof(offset), &offset)) opt_offset = offset;
-
-            // MatrixStride decorations can be applied to struct members, so make sure to check for their presence
-            mod.get_member_decoration(inst.result_id, i, spv::Decoration::MatrixStride, sizeof(matrix_stride), &matrix_stride);
-            r.members.push_back({mod.get_member_name(inst.result_id, i), convert_type(mod, mod.get_instruction(inst.var_ids[i]), matrix_stride), opt_offset});
+        case spec_op::literal: case spec_op::constant: return 0;
+        case spec_op::uconvert: case spec_op::sconvert: case spec_op::negate: case spec_op::bitwise_not: case spec_op::logical_not: return 1;
+        case spec_op::select: return 3;
+        default: return 2;
         }
-        return {r};    
     }
 
-    if(inst.op_code == spv::Op::OpTypeArray)
+    // Evaluates an operation other than a literal or constant, given the values of its operands, each zero extended from the given width
+    reflection_failure evaluate_op(spec_op::code op, uint32_t width, const uint64_t * a, const uint32_t * w, uint64_t & result)
     {
-        // Note: Input/output arrays might not have a physical layout, so ArrayStride may not always be present
-        std::optional<size_t> opt_stride; uint32_t stride;
-        if(mod.get_decoration(inst.result_id, spv::Decoration::ArrayStride, sizeof(stride), &stride)) opt_stride = stride;
-        return {spvi::type::array{convert_type(mod, mod.get_instruction(inst.ids[0]), matrix_stride), decode_array_length(mod, mod.get_instruction(inst.ids[1])), opt_stride}};
+        auto s = [&](int k) { return sign_extend(a[k], w[k]); };
+        const bool is_division = op == spec_op::udiv || op == spec_op::umod || op == spec_op::sdiv || op == spec_op::srem || op == spec_op::smod;
+        if(is_division && a[1] == 0) return {errc::invalid_module, "division by zero in specialization constant", nullptr};
+        uint64_t r = 0;
+        switch(op)
+        {
+        case spec_op::uconvert: r = a[0]; break;
+        case spec_op::sconvert: r = static_cast<uint64_t>(s(0)); break;
+        case spec_op::select: r = a[0] ? a[1] : a[2]; break;
+        case spec_op::negate: r = 0 - a[0]; break;
+        case spec_op::add: r = a[0] + a[1]; break;
+        case spec_op::sub: r = a[0] - a[1]; break;
+        case spec_op::mul: r = a[0] * a[1]; break;
+        case spec_op::udiv: r = a[0] / a[1]; break;
+        case spec_op::umod: r = a[0] % a[1]; break;
+        case spec_op::sdiv: r = s(1) == -1 ? 0 - a[0] : static_cast<uint64_t>(s(0) / s(1)); break; // Dividing the most negative value by -1 wraps rather than overflowing
+        case spec_op::srem: r = s(1) == -1 ? 0 : static_cast<uint64_t>(s(0) % s(1)); break;
+        case spec_op::smod:
+        {
+            // The result of SMod takes the sign of the divisor, rather than of the dividend
+            const int64_t m = s(1) == -1 ? 0 : s(0) % s(1);
+            r = static_cast<uint64_t>(m != 0 && (m < 0) != (s(1) < 0) ? m + s(1) : m);
+            break;
+        }
+        case spec_op::shift_left: r = a[0] << (a[1] & 63); break;
+        case spec_op::shift_right_logical: r = a[0] >> (a[1] & 63); break;
+        case spec_op::shift_right_arithmetic: r = static_cast<uint64_t>(s(0) >> (a[1] & 63)); break;
+        case spec_op::bitwise_or: r = a[0] | a[1]; break;
+        case spec_op::bitwise_xor: r = a[0] ^ a[1]; break;
+        case spec_op::bitwise_and: r = a[0] & a[1]; break;
+        case spec_op::bitwise_not: r = ~a[0]; break;
+        case spec_op::logical_or: r = a[0] || a[1]; break;
+        case spec_op::logical_and: r = a[0] && a[1]; break;
+        case spec_op::logical_not: r = !a[0]; break;
+        case spec_op::equal: r = a[0] == a[1]; break;
+        case spec_op::not_equal: r = a[0] != a[1]; break;
+        case spec_op::ult: r = a[0] < a[1]; break;
+        case spec_op::slt: r = s(0) < s(1); break;
+        case spec_op::ule: r = a[0] <= a[1]; break;
+        case spec_op::sle: r = s(0) <= s(1); break;
+        case spec_op::ugt: r = a[0] > a[1]; break;
+        case spec_op::sgt: r = s(0) > s(1); break;
+        case spec_op::uge: r = a[0] >= a[1]; break;
+        case spec_op::sge: r = s(0) >= s(1); break;
+        default: return {errc::invalid_module, "bad specialization op", nullptr};
+        }
+        result = truncate_bits(r, width);
+        return {errc::success, nullptr, nullptr};
     }
 
-    if(inst.op_code == spv::Op::OpTypeSampledImage)
+    // Evaluates every operation of a specialization program, given the value of each specialization constant, and throws if any is undefined
+    std::vector<uint64_t> evaluate_program(const std::vector<spec_op> & program, const std::vector<uint64_t> & constant_values)
     {
-        auto image_inst = mod.get_instruction(inst.ids[0]);
-        if(image_inst.op_code != spv::Op::OpTypeImage) throw std::logic_error("not an image type");
-
-        spvi::type::sampler s {};
-        s.channel_kind = convert_numeric_type(mod, mod.get_instruction(image_inst.ids[0]), 0).elem_kind;
-        const bool is_array = image_inst.nums[1] == 1;
-        switch(image_inst.dim)
+        std::vector<uint64_t> results(program.size());
+        for(size_t i=0; i<program.size(); ++i)
         {
-        case spv::Dim::Dim1D: s.view_type = is_array ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D; break;
-        case spv::Dim::Dim2D: s.view_type = is_array ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D; break;
-        case spv::Dim::Dim3D: s.view_type = VK_IMAGE_VIEW_TYPE_3D; break;
-        case spv::Dim::Cube: s.view_type = is_array ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE; break;
-        default: throw std::logic_error("unsupported image Dim"); break;
+            auto & op = program[i];
+            if(op.op == spec_op::literal) results[i] = op.value;
+            else if(op.op == spec_op::constant) results[i] = op.width == 1 ? constant_values[op.operands[0]] != 0 : truncate_bits(constant_values[op.operands[0]], op.width);
+            else
+            {
+                uint64_t a[3] {}; uint32_t w[3] {};
+                for(int k=0, n=get_operand_count(op.op); k<n; ++k) { a[k] = results[op.operands[k]]; w[k] = program[op.operands[k]].width; }
+                if(auto failure = evaluate_op(op.op, op.width, a, w, results[i])) throw reflection_exception<std::logic_error>{failure.code, failure.message, failure.word};
+            }
         }
-        if(image_inst.nums[2] == 1) s.is_multisampled = true;
-        if(image_inst.nums[0] == 1) s.is_shadow = true;
-        return {s};
+        return results;
     }
 
-    return {convert_numeric_type(mod, inst, matrix_stride)};
+    // Returns the value of each specialization constant, which is its default unless another value is given for its constant_id
+    template<class C> std::vector<uint64_t> get_constant_values(const std::vector<C> & constants, const spvi::specialization_value * values, size_t value_count)
+    {
+        std::vector<uint64_t> r;
+        r.reserve(constants.size());
+        for(auto & c : constants) r.push_back(c.default_value);
+        for(size_t i=0; i<value_count; ++i)
+        {
+            // Vulkan permits values for constant IDs which the module does not use, and these are ignored
+            auto it = std::lower_bound(begin(constants), end(constants), values[i].constant_id, [](const C & c, uint32_t id) { return c.constant_id < id; });
+            if(it != end(constants) && it->constant_id == values[i].constant_id) r[it - begin(constants)] = values[i].value;
+        }
+        return r;
+    }
 }
 
-static spvi::descriptor_set_info & get_set(std::vector<spvi::descriptor_set_info> & sets, uint32_t index)
+bool spvi::is_row_major(const type::numeric & x) { return x.column_count > 1 && x.column_stride == x.elem_width / 8 && x.row_stride > x.column_stride; }
+size_t spvi::get_numeric_size(const type::numeric & x)
 {
-    for(auto & set : sets) if(set.set == index) return set;
-    sets.push_back({index});
-    return sets.back();
+    if(x.column_count == 1) return x.row_count * x.elem_width / 8;
+    if(is_row_major(x)) return x.row_count * x.row_stride;
+    return x.column_count * (x.column_stride ? x.column_stride : x.row_count * x.elem_width / 8);
 }
+uint64_t spvi::hash_combine(uint64_t seed, uint64_t value) { return seed ^ (value + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2)); }
 
-spvi::module_info::module_info(const uint32_t * words, size_t word_count)
+namespace
 {
-    module mod = load_module(words, word_count);
+    // Primitives for structural type hashes, which must give the same results on every platform, so std::hash is not used
+    using spvi::hash_combine;
+    uint64_t hash_optional(const std::optional<size_t> & value) { return value ? hash_combine(1, *value) : 0; }
+    uint64_t hash_string(const char * s) { uint64_t h = 0xcbf29ce484222325; for(; *s; ++s) h = (h ^ static_cast<uint8_t>(*s)) * 0x100000001b3; return h; } // FNV-1a
+
+    // Each kind of type is seeded with its index within spvi::type::contents, and composite types fold in the hashes of the types they refer to
+    uint64_t hash_sampler(const spvi::type::sampler & s) { uint64_t h = 0; for(uint64_t v : {uint64_t(s.channel_kind), uint64_t(s.view_type), uint64_t(s.is_multisampled), uint64_t(s.is_shadow)}) h = hash_combine(h, v); return h; }
+    uint64_t hash_numeric(const spvi::type::numeric & x) { uint64_t h = 1; for(uint64_t v : {uint64_t(x.elem_kind), uint64_t(x.elem_width), uint64_t(x.row_count), uint64_t(x.column_count), uint64_t(x.row_stride), uint64_t(x.column_stride)}) h = hash_combine(h, v); return h; }
+    uint64_t hash_array(uint64_t elem_type_hash, size_t elem_count, const std::optional<size_t> & stride, const std::optional<uint32_t> & elem_count_expression)
+    {
+        // Only whether the length is specialized is hashed, as expressions are only comparable within the same module
+        uint64_t h = 2; for(uint64_t v : {elem_type_hash, uint64_t(elem_count), hash_optional(stride)}) h = hash_combine(h, v);
+        return elem_count_expression ? hash_combine(h, 1) : h;
+    }
+    uint64_t hash_structure(const char * name, size_t member_count) { return hash_combine(hash_combine(3, hash_string(name)), member_count); }
+    uint64_t hash_member(uint64_t h, const char * name, uint64_t member_type_hash, const std::optional<size_t> & offset) { for(uint64_t v : {hash_string(name), member_type_hash, hash_optional(offset)}) h = hash_combine(h, v); return h; }
+    uint64_t hash_image(const spvi::type::image & i) { uint64_t h = 4; for(uint64_t v : {uint64_t(i.channel_kind), uint64_t(i.view_type), uint64_t(i.is_multisampled), uint64_t(i.is_shadow), uint64_t(i.is_storage), uint64_t(i.format)}) h = hash_combine(h, v); return h; }
+    uint64_t hash_separate_sampler() { return 5; }
+
+    // Hash and size of a node of a type_graph, which depend on those of the nodes it refers to
+    uint64_t hash_node(const spvi::type_graph & graph, const spvi::type_graph::node & n)
+    {
+        if(auto * s = std::get_if<spvi::type::sampler>(&n.contents)) return hash_sampler(*s);
+        if(auto * x = std::get_if<spvi::type::numeric>(&n.contents)) return hash_numeric(*x);
+        if(auto * i = std::get_if<spvi::type::image>(&n.contents)) return hash_image(*i);
+        if(std::holds_alternative<spvi::type::separate_sampler>(n.contents)) return hash_separate_sampler();
+        if(auto * a = std::get_if<spvi::type_graph::array>(&n.contents)) return hash_array(graph.types[a->elem_type].hash, a->elem_count, a->stride, a->elem_count_expression);
+        auto & s = std::get<spvi::type_graph::structure>(n.contents);
+        uint64_t h = hash_structure(graph.get_string(s.name), s.member_count);
+        for(uint32_t i=0; i<s.member_count; ++i)
+        {
+            auto & m = graph.members[s.first_member + i];
+            h = hash_member(h, graph.get_string(m.name), graph.types[m.member_type].hash, m.offset);
+        }
+        return h;
+    }
+
+    size_t size_node(const spvi::type_graph & graph, const spvi::type_graph::node & n)
+    {
+        if(auto * x = std::get_if<spvi::type::numeric>(&n.contents)) return get_numeric_size(*x);
+        if(auto * a = std::get_if<spvi::type_graph::array>(&n.contents)) return a->elem_count * (a->stride ? *a->stride : graph.types[a->elem_type].size);
+        if(auto * s = std::get_if<spvi::type_graph::structure>(&n.contents))
+        {
+            // Members without an explicit offset are assumed to be tightly packed
+            size_t size = 0;
+            for(uint32_t i=0; i<s->member_count; ++i)
+            {
+                auto & m = graph.members[s->first_member + i];
+                size = std::max(size, (m.offset ? *m.offset : size) + graph.types[m.member_type].size);
+            }
+            return size;
+        }
+        return 0;
+    }
 
-    for(const auto & inst : mod.instructions)
+    // Appends strings and types to a type_graph, reusing any identical string or type which is already present
+    class type_graph_builder
     {
-        // Uniform blocks have storage class Uniform and samplers have storage class UniformConstant
-        if(inst.op_code == spv::Op::OpVariable && (inst.storage_class == spv::StorageClass::Uniform || inst.storage_class == spv::StorageClass::UniformConstant))
+        spvi::type_graph & graph;
+        std::unordered_multimap<size_t, spvi::type_graph::string_index> string_table;
+        std::unordered_multimap<uint64_t, spvi::type_graph::type_index> type_table;
+
+        static bool equal_members(const spvi::type_graph::member & a, const spvi::type_graph::member & b) { return std::tie(a.name, a.member_type, a.offset) == std::tie(b.name, b.member_type, b.offset); }
+
+        bool equal_nodes(const spvi::type_graph::node & a, const spvi::type_graph::node & b) const
         {
-            uint32_t set, binding;
-            if(!mod.get_decoration(inst.result_id, spv::Decoration::DescriptorSet, sizeof(set), &set)) throw std::logic_error("missing set qualifier");
-            if(!mod.get_decoration(inst.result_id, spv::Decoration::Binding, sizeof(binding), &binding)) throw std::logic_error("missing binding qualifier");
+            if(a.contents.index() != b.contents.index()) return false;
+            if(auto * x = std::get_if<spvi::type::sampler>(&a.contents)) return *x == std::get<spvi::type::sampler>(b.contents);
+            if(auto * x = std::get_if<spvi::type::numeric>(&a.contents)) return *x == std::get<spvi::type::numeric>(b.contents);
+            if(auto * x = std::get_if<spvi::type::image>(&a.contents)) return *x == std::get<spvi::type::image>(b.contents);
+            if(std::holds_alternative<spvi::type::separate_sampler>(a.contents)) return true;
+            if(auto * x = std::get_if<spvi::type_graph::array>(&a.contents)) { auto & y = std::get<spvi::type_graph::array>(b.contents); return std::tie(x->elem_type, x->elem_count, x->stride, x->elem_count_expression) == std::tie(y.elem_type, y.elem_count, y.stride, y.elem_count_expression); }
+            auto & x = std::get<spvi::type_graph::structure>(a.contents), & y = std::get<spvi::type_graph::structure>(b.contents);
+            if(x.name != y.name || x.member_count != y.member_count) return false;
+            for(uint32_t i=0; i<x.member_count; ++i) if(!equal_members(graph.members[x.first_member + i], graph.members[y.first_member + i])) return false;
+            return true;
+        }
+    public:
+        type_graph_builder(spvi::type_graph & graph) : graph{graph} {}
 
-            auto type_inst = mod.get_instruction(inst.ids[0]);
-            if(type_inst.op_code != spv::Op::OpTypePointer) throw std::logic_error("uniform variable type is not a pointer");           
-            get_set(descriptor_sets, set).descriptors.push_back({binding, convert_type(mod, mod.get_instruction(type_inst.ids[0]), 0), mod.get_name(inst.result_id)});
+        const spvi::type_graph & get_graph() const { return graph; }
+
+        spvi::type_graph::string_index intern_string(const char * s)
+        {
+            const size_t length = strlen(s), h = std::hash<std::string_view>{}({s, length});
+            for(auto range = string_table.equal_range(h); range.first != range.second; ++range.first)
+            {
+                if(strcmp(graph.get_string(range.first->second), s) == 0) return range.first->second;
+            }
+            const auto index = static_cast<spvi::type_graph::string_index>(graph.strings.size());
+            graph.strings.insert(end(graph.strings), s, s + length + 1);
+            string_table.emplace(h, index);
+            return index;
         }
 
-        if(inst.op_code == spv::Op::OpEntryPoint)
+        spvi::type_graph::type_index intern_type(spvi::type_graph::node n)
         {
-            entry_point_info e;
-            switch(inst.execution_model)
+            n.hash = hash_node(graph, n);
+            n.size = size_node(graph, n);
+            for(auto range = type_table.equal_range(n.hash); range.first != range.second; ++range.first)
             {
-            case spv::ExecutionModel::Vertex: e.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
-            case spv::ExecutionModel::TessellationControl: e.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break;
-            case spv::ExecutionModel::TessellationEvaluation: e.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break;
-            case spv::ExecutionModel::Geometry: e.stage = VK_SHADER_STAGE_GEOMETRY_BIT; break;
-            case spv::ExecutionModel::Fragment: e.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
-            case spv::ExecutionModel::GLCompute: e.stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
-            default: throw std::logic_error("bad ExecutionModel");
+                if(equal_nodes(graph.types[range.first->second], n)) return range.first->second;
             }
-            e.name = inst.string;
-            for(auto id : inst.var_ids)
+            const auto index = static_cast<spvi::type_graph::type_index>(graph.types.size());
+            graph.types.push_back(n);
+            type_table.emplace(n.hash, index);
+            return index;
+        }
+
+        spvi::type_graph::type_index intern_structure(spvi::type_graph::string_index name, const std::vector<spvi::type_graph::member> & members)
+        {
+            // The members are appended so that the structure can be compared against existing ones, and removed again if it turns out to be a duplicate
+            const auto first_member = static_cast<uint32_t>(graph.members.size());
+            graph.members.insert(graph.members.end(), members.begin(), members.end());
+            const auto index = intern_type({spvi::type_graph::structure{name, first_member, static_cast<uint32_t>(members.size())}});
+            if(std::get<spvi::type_graph::structure>(graph.types[index].contents).first_member != first_member) graph.members.resize(first_member);
+            return index;
+        }
+    };
+
+    // Reflects the specialization constants of a module, and compiles the constant instructions which determine array lengths into a specialization 
+    // program. Values which do not depend on any specialization constant are folded as they are compiled, so that only the operations which must be
+    // re-evaluated for each variant are emitted, and arrays of constant length are not specialized at all.
+    class specialization_compiler
+    {
+        // The value of a constant for the default values of the specialization constants, and the operation which computes it, if it depends on them
+        struct compiled_value { uint64_t value; uint32_t width; uint32_t op_index; };
+
+        const module & mod;
+        std::vector<spvi::flat_specialization_constant_info> & constants;
+        std::vector<spec_op> & program;
+        std::unordered_map<uint32_t, uint32_t> constant_indices;    // Index within constants, by result ID
+        std::unordered_map<uint32_t, compiled_value> compiled;      // By result ID
+
+        static reflection_failure get_op_code(spv::Op op, spec_op::code & code)
+        {
+            code = spec_op::literal;
+            switch(op)
             {
-                // Skip over inputs/outputs without an explicit location (such as the BuiltIn block)
-                uint32_t location;
-                if(!mod.get_decoration(id, spv::Decoration::Location, sizeof(location), &location)) continue;
+            case spv::Op::OpUConvert: code = spec_op::uconvert; break;
+            case spv::Op::OpSConvert: code = spec_op::sconvert; break;
+            case spv::Op::OpSelect: code = spec_op::select; break;
+            case spv::Op::OpSNegate: code = spec_op::negate; break;
+            case spv::Op::OpIAdd: code = spec_op::add; break;
+            case spv::Op::OpISub: code = spec_op::sub; break;
+            case spv::Op::OpIMul: code = spec_op::mul; break;
+            case spv::Op::OpUDiv: code = spec_op::udiv; break;
+            case spv::Op::OpSDiv: code = spec_op::sdiv; break;
+            case spv::Op::OpUMod: code = spec_op::umod; break;
+            case spv::Op::OpSRem: code = spec_op::srem; break;
+            case spv::Op::OpSMod: code = spec_op::smod; break;
+            case spv::Op::OpShiftLeftLogical: code = spec_op::shift_left; break;
+            case spv::Op::OpShiftRightLogical: code = spec_op::shift_right_logical; break;
+            case spv::Op::OpShiftRightArithmetic: code = spec_op::shift_right_arithmetic; break;
+            case spv::Op::OpBitwiseOr: code = spec_op::bitwise_or; break;
+            case spv::Op::OpBitwiseXor: code = spec_op::bitwise_xor; break;
+            case spv::Op::OpBitwiseAnd: code = spec_op::bitwise_and; break;
+            case spv::Op::OpNot: code = spec_op::bitwise_not; break;
+            case spv::Op::OpLogicalOr: code = spec_op::logical_or; break;
+            case spv::Op::OpLogicalAnd: code = spec_op::logical_and; break;
+            case spv::Op::OpLogicalNot: code = spec_op::logical_not; break;
+            case spv::Op::OpLogicalEqual: case spv::Op::OpIEqual: code = spec_op::equal; break;
+            case spv::Op::OpLogicalNotEqual: case spv::Op::OpINotEqual: code = spec_op::not_equal; break;
+            case spv::Op::OpULessThan: code = spec_op::ult; break;
+            case spv::Op::OpSLessThan: code = spec_op::slt; break;
+            case spv::Op::OpULessThanEqual: code = spec_op::ule; break;
+            case spv::Op::OpSLessThanEqual: code = spec_op::sle; break;
+            case spv::Op::OpUGreaterThan: code = spec_op::ugt; break;
+            case spv::Op::OpSGreaterThan: code = spec_op::sgt; break;
+            case spv::Op::OpUGreaterThanEqual: code = spec_op::uge; break;
+            case spv::Op::OpSGreaterThanEqual: code = spec_op::sge; break;
+            default: return {errc::unsupported, "unsupported specialization constant operation", nullptr};
+            }
+            return {errc::success, nullptr, nullptr};
+        }
+
+        // Width in bits of an integer or boolean result type
+        reflection_failure get_width(uint32_t type_id, uint32_t & width) const
+        {
+            const instruction * type;
+            if(auto failure = mod.get_instruction(type_id, type)) return failure;
+            if(type->op_code == spv::Op::OpTypeBool) width = 1;
+            else if(type->op_code == spv::Op::OpTypeInt && type->num(0) <= 64) width = type->num(0);
+            else return {errc::invalid_module, "array length not an integer constant", type->first};
+            return {errc::success, nullptr, nullptr};
+        }
+
+        uint32_t emit(const spec_op & op)
+        {
+            program.push_back(op);
+            return static_cast<uint32_t>(program.size() - 1);
+        }
 
-                auto iface = mod.get_instruction(id);
-                auto type_inst = mod.get_instruction(iface.ids[0]);
-                if(type_inst.op_code != spv::Op::OpTypePointer) throw std::logic_error("interface variable type is not a pointer");
+        // Operands which do not depend on specialization constants are only emitted when an operation which does depend on them refers to them
+        uint32_t emit_operand(const compiled_value & v) { return v.op_index != none ? v.op_index : emit({spec_op::literal, v.width, {}, v.value}); }
+
+        reflection_failure compile(const instruction & inst, compiled_value & v)
+        {
+            auto it = compiled.find(inst.result_id);
+            if(it != compiled.end())
+            {
+                if(it->second.width == 0) return {errc::invalid_module, "recursive constant", inst.first};
+                v = it->second;
+                return {errc::success, nullptr, nullptr};
+            }
+            compiled.emplace(inst.result_id, compiled_value{0, 0, none}); // Marks the constant as in progress, so that malformed modules with cyclic constants are rejected
+            if(auto failure = compile_value(inst, v)) return failure;
+            compiled[inst.result_id] = v;
+            return {errc::success, nullptr, nullptr};
+        }
 
-                variable_info info {location, convert_type(mod, mod.get_instruction(type_inst.ids[0]), 0), mod.get_name(id)};
-                switch(iface.storage_class)
+        reflection_failure compile_value(const instruction & inst, compiled_value & v)
+        {
+            v.op_index = none;
+            switch(inst.op_code)
+            {
+            case spv::Op::OpConstantTrue: v.value = 1; v.width = 1; break;
+            case spv::Op::OpConstantFalse: v.value = 0; v.width = 1; break;
+            case spv::Op::OpConstant:
+                if(auto failure = decode_constant_bits(mod, inst, v.value)) return failure;
+                return get_width(inst.id(0), v.width);
+            case spv::Op::OpSpecConstantTrue: case spv::Op::OpSpecConstantFalse: case spv::Op::OpSpecConstant:
+            {
+                // Constants without a SpecId cannot be specialized, and so are treated as ordinary constants
+                if(auto failure = get_width(inst.id(0), v.width)) return failure;
+                if(inst.op_code != spv::Op::OpSpecConstant) v.value = inst.op_code == spv::Op::OpSpecConstantTrue;
+                else if(auto failure = decode_constant_bits(mod, inst, v.value)) return failure;
+                auto it = constant_indices.find(inst.result_id);
+                if(it != constant_indices.end()) v.op_index = emit({spec_op::constant, v.width, {it->second}, 0});
+                break;
+            }
+            case spv::Op::OpSpecConstantOp:
+            {
+                spec_op op {spec_op::literal, 0, {}, 0};
+                if(auto failure = get_op_code(static_cast<spv::Op>(inst.num(0)), op.op)) return {failure.code, failure.message, inst.first};
+                if(auto failure = get_width(inst.id(0), op.width)) return failure;
+                const auto operand_ids = inst.var_ids();
+                if(operand_ids.size() != static_cast<size_t>(get_operand_count(op.op))) return {errc::invalid_module, "wrong number of operands", inst.first};
+                compiled_value operands[3]; uint64_t a[3] {}; uint32_t w[3] {}; bool specialized = false;
+                for(size_t k=0; k<operand_ids.size(); ++k)
                 {
-                case spv::StorageClass::Input: e.inputs.push_back(info); break;
-                case spv::StorageClass::Output: e.outputs.push_back(info); break;
-                default: throw std::logic_error("bad storage class");
+                    const instruction * operand;
+                    if(auto failure = mod.get_instruction(operand_ids[k], operand)) return failure;
+                    if(auto failure = compile(*operand, operands[k])) return failure;
+                    a[k] = operands[k].value;
+                    w[k] = operands[k].width;
+                    specialized |= operands[k].op_index != none;
                 }
+                if(auto failure = evaluate_op(op.op, op.width, a, w, v.value)) return {failure.code, failure.message, inst.first};
+                v.width = op.width;
+                if(!specialized) break;
+                for(size_t k=0; k<operand_ids.size(); ++k) op.operands[k] = emit_operand(operands[k]);
+                v.op_index = emit(op);
+                break;
             }
-            entry_points.push_back(std::move(e));
+            default: return {errc::invalid_module, "array length not a constant value", inst.first};
+            }
+            return {errc::success, nullptr, nullptr};
         }
-    }
+    public:
+        specialization_compiler(const module & mod, std::vector<spvi::flat_specialization_constant_info> & constants, std::vector<spec_op> & program) : 
+            mod{mod}, constants{constants}, program{program} {}
 
-    std::sort(begin(descriptor_sets), end(descriptor_sets), [](auto & l, auto & r) { return l.set < r.set; });
-    for(auto & set : descriptor_sets) std::sort(begin(set.descriptors), end(set.descriptors), [](auto & l, auto & r) { return l.index < r.index; });
+        // Reflects the constants which have a SpecId, ordered by constant_id, which must be done before any array length is compiled
+        reflection_failure reflect_constants(type_graph_builder & builder)
+        {
+            std::vector<std::pair<spvi::flat_specialization_constant_info, uint32_t>> found;
+            for(auto & inst : mod.instructions)
+            {
+                if(inst.op_code != spv::Op::OpSpecConstantTrue && inst.op_code != spv::Op::OpSpecConstantFalse && inst.op_code != spv::Op::OpSpecConstant) continue;
+                uint32_t constant_id;
+                if(!mod.get_decoration(inst.result_id, spv::Decoration::SpecId, constant_id)) continue;
 
-    std::sort(begin(entry_points), end(entry_points), [](auto & l, auto & r) { return std::tie(l.stage, l.name) < std::tie(r.stage, r.name); });
-    for(auto & e : entry_points)
-    {
-        std::sort(begin(e.inputs), end(e.inputs), [](auto & l, auto & r) { return l.index < r.index; });
-        std::sort(begin(e.outputs), end(e.outputs), [](auto & l, auto & r) { return l.index < r.index; });
-    }
+                const char * name = mod.find_name(inst.result_id);
+                spvi::flat_specialization_constant_info c {constant_id, builder.intern_string(name ? name : ""), spvi::type::uint_, 32, true, inst.op_code == spv::Op::OpSpecConstantTrue};
+                if(inst.op_code == spv::Op::OpSpecConstant)
+                {
+                    const instruction * type;
+                    if(auto failure = mod.get_instruction(inst.id(0), type)) return failure;
+                    c.elem_kind = type->op_code == spv::Op::OpTypeFloat ? spvi::type::float_ : type->num(1) ? spvi::type::int_ : spvi::type::uint_;
+                    c.elem_width = type->num(0);
+                    c.is_bool = false;
+                    if(auto failure = decode_constant_bits(mod, inst, c.default_value)) return failure;
+                }
+                found.push_back({c, inst.result_id});
+            }
+
+            std::sort(begin(found), end(found), [](auto & l, auto & r) { return l.first.constant_id < r.first.constant_id; });
+            for(auto & f : found)
+            {
+                constant_indices[f.second] = static_cast<uint32_t>(constants.size());
+                constants.push_back(f.first);
+            }
+            return {errc::success, nullptr, nullptr};
+        }
+
+        // Finds the default value of a constant, and the index of the operation which computes it if it depends on any specialization constant
+        reflection_failure compile_length(const instruction & inst, std::pair<uint64_t, std::optional<uint32_t>> & length)
+        {
+            compiled_value v;
+            if(auto failure = compile(inst, v)) return failure;
+            length = {v.value, v.op_index != none ? std::optional<uint32_t>{v.op_index} : std::nullopt};
+            return {errc::success, nullptr, nullptr};
+        }
+    };
+
+    // Converts the types of a single module into a type_graph, converting each combination of type ID and matrix stride only once
+    class type_converter
+    {
+        const module & mod;
+        type_graph_builder & builder;
+        specialization_compiler & specialization;
+        std::unordered_map<uint64_t, spvi::type_graph::type_index> converted;
+    public:
+        lookup_counter cache_hits;
+
+        type_converter(const module & mod, type_graph_builder & builder, specialization_compiler & specialization) : mod{mod}, builder{builder}, specialization{specialization} {}
+
+        size_t get_conversion_count() const { return converted.size(); }
+
+        reflection_failure convert(const instruction & inst, uint32_t matrix_stride, bool row_major, spvi::type_graph::type_index & index)
+        {
+            // The layout is packed below the ID, as any MatrixStride of 2^31 bytes or more would exceed every buffer that could hold the matrix
+            const uint64_t key = uint64_t(inst.result_id) << 32 | uint32_t(matrix_stride << 1) | uint32_t(row_major);
+            auto it = converted.find(key);
+            if(it != converted.end())
+            {
+                if(it->second == none) return {errc::invalid_module, "recursive type", inst.first};
+                cache_hits.add();
+                index = it->second;
+                return {errc::success, nullptr, nullptr};
+            }
+            converted.emplace(key, none); // Marks the type as in progress, so that malformed modules with cyclic types are rejected rather than recursing forever
+
+            const instruction * elem_inst;
+            spvi::type_graph::type_index elem_type;
+            if(inst.op_code == spv::Op::OpTypeStruct)
+            {
+                // Convert all member types before appending any members, so that the members of nested structures do not end up interleaved
+                std::vector<spvi::type_graph::member> members;
+                for(size_t i=0; i<inst.var_ids().size(); ++i)
+                {
+                    // Note: Input/output structs might not have a physical layout, so Offset may not always be present
+                    std::optional<size_t> opt_offset; uint32_t offset;
+                    if(mod.get_member_decoration(inst.result_id, i, spv::Decoration::Offset, offset)) opt_offset = offset;
+
+                    // MatrixStride and RowMajor/ColMajor decorations can be applied to struct members, so make sure to check for their presence
+                    uint32_t member_matrix_stride = matrix_stride;
+                    mod.get_member_decoration(inst.result_id, i, spv::Decoration::MatrixStride, member_matrix_stride);
+                    bool member_row_major = row_major;
+                    if(mod.has_member_decoration(inst.result_id, i, spv::Decoration::RowMajor)) member_row_major = true;
+                    if(mod.has_member_decoration(inst.result_id, i, spv::Decoration::ColMajor)) member_row_major = false;
+                    if(auto failure = mod.get_instruction(inst.var_ids()[i], elem_inst)) return failure;
+                    if(auto failure = convert(*elem_inst, member_matrix_stride, member_row_major, elem_type)) return failure;
+                    members.push_back({builder.intern_string(mod.get_member_name(inst.result_id, i)), elem_type, opt_offset});
+                }
+                index = builder.intern_structure(builder.intern_string(mod.get_name(inst.result_id)), members);
+            }
+            else if(inst.op_code == spv::Op::OpTypeArray)
+            {
+                // Note: Input/output arrays might not have a physical layout, so ArrayStride may not always be present
+                std::optional<size_t> opt_stride; uint32_t stride;
+                if(mod.get_decoration(inst.result_id, spv::Decoration::ArrayStride, stride)) opt_stride = stride;
+                const instruction * length_inst;
+                std::pair<uint64_t, std::optional<uint32_t>> length;
+                if(auto failure = mod.get_instruction(inst.id(1), length_inst)) return failure;
+                if(auto failure = specialization.compile_length(*length_inst, length)) return failure;
+                if(auto failure = mod.get_instruction(inst.id(0), elem_inst)) return failure;
+                if(auto failure = convert(*elem_inst, matrix_stride, row_major, elem_type)) return failure;
+                index = builder.intern_type({spvi::type_graph::array{elem_type, static_cast<size_t>(length.first), opt_stride, length.second}});
+            }
+            else if(inst.op_code == spv::Op::OpTypeRuntimeArray)
+            {
+                std::optional<size_t> opt_stride; uint32_t stride;
+                if(mod.get_decoration(inst.result_id, spv::Decoration::ArrayStride, stride)) opt_stride = stride;
+                if(auto failure = mod.get_instruction(inst.id(0), elem_inst)) return failure;
+                if(auto failure = convert(*elem_inst, matrix_stride, row_major, elem_type)) return failure;
+                index = builder.intern_type({spvi::type_graph::array{elem_type, 0, opt_stride}});
+            }
+            else if(inst.op_code == spv::Op::OpTypeSampledImage)
+            {
+                spvi::type::sampler sampler;
+                if(auto failure = convert_sampler_type(mod, inst, sampler)) return failure;
+                index = builder.intern_type({sampler});
+            }
+            else if(inst.op_code == spv::Op::OpTypeImage)
+            {
+                spvi::type::image image;
+                if(auto failure = convert_image_type(mod, inst, image)) return failure;
+                index = builder.intern_type({image});
+            }
+            else if(inst.op_code == spv::Op::OpTypeSampler) index = builder.intern_type({spvi::type::separate_sampler{}});
+            else
+            {
+                spvi::type::numeric numeric;
+                if(auto failure = convert_numeric_type(mod, inst, matrix_stride, row_major, numeric)) return failure;
+                index = builder.intern_type({numeric});
+            }
+
+            converted[key] = index;
+            return {errc::success, nullptr, nullptr};
+        }
+    };
+}
+
+spvi::type spvi::type_graph::get_type(type_index index) const
+{
+    auto & n = types[index];
+    if(auto * s = std::get_if<type::sampler>(&n.contents)) return {*s};
+    if(auto * x = std::get_if<type::numeric>(&n.contents)) return {*x};
+    if(auto * i = std::get_if<type::image>(&n.contents)) return {*i};
+    if(auto * z = std::get_if<type::separate_sampler>(&n.contents)) return {*z};
+    if(auto * a = std::get_if<array>(&n.contents)) return {type::array{get_type(a->elem_type), a->elem_count, a->stride, a->elem_count_expression}};
+    auto & s = std::get<structure>(n.contents);
+    type::structure r {get_string(s.name), {}, n.size};
+    r.members.reserve(s.member_count);
+    for(uint32_t i=0; i<s.member_count; ++i)
+    {
+        auto & m = members[s.first_member + i];
+        r.members.push_back({get_string(m.name), get_type(m.member_type), m.offset, types[m.member_type].size});
+    }
+    return {std::move(r)};
+}
+
+std::vector<spvi::indirect<spvi::type>> spvi::type_graph::get_types() const
+{
+    // Types only refer to types with lower indices, so a single pass in index order can share the nodes which have already been converted
+    std::vector<indirect<type>> r;
+    r.reserve(types.size());
+    for(auto & n : types)
+    {
+        if(auto * s = std::get_if<type::sampler>(&n.contents)) r.push_back(type{*s});
+        else if(auto * x = std::get_if<type::numeric>(&n.contents)) r.push_back(type{*x});
+        else if(auto * i = std::get_if<type::image>(&n.contents)) r.push_back(type{*i});
+        else if(auto * z = std::get_if<type::separate_sampler>(&n.contents)) r.push_back(type{*z});
+        else if(auto * a = std::get_if<array>(&n.contents)) r.push_back(type{type::array{r[a->elem_type], a->elem_count, a->stride, a->elem_count_expression}});
+        else
+        {
+            auto & s = std::get<structure>(n.contents);
+            type::structure t {get_string(s.name), {}, n.size};
+            t.members.reserve(s.member_count);
+            for(uint32_t i=0; i<s.member_count; ++i)
+            {
+                auto & m = members[s.first_member + i];
+                t.members.push_back({get_string(m.name), r[m.member_type], m.offset, types[m.member_type].size});
+            }
+            r.push_back(type{std::move(t)});
+        }
+    }
+    return r;
+}
+
+bool spvi::operator == (const type::sampler & a, const type::sampler & b) { return std::tie(a.channel_kind, a.view_type, a.is_multisampled, a.is_shadow) == std::tie(b.channel_kind, b.view_type, b.is_multisampled, b.is_shadow); }
+bool spvi::operator == (const type::numeric & a, const type::numeric & b) { return std::tie(a.elem_kind, a.elem_width, a.row_count, a.column_count, a.row_stride, a.column_stride) == std::tie(b.elem_kind, b.elem_width, b.row_count, b.column_count, b.row_stride, b.column_stride); }
+bool spvi::operator == (const type::array & a, const type::array & b) { return a.elem_count == b.elem_count && a.stride == b.stride && a.elem_count_expression == b.elem_count_expression && (a.elem_type.shares_value_with(b.elem_type) || static_cast<const type &>(a.elem_type) == b.elem_type); }
+bool spvi::operator == (const type::structure::member & a, const type::structure::member & b) { return a.name == b.name && a.offset == b.offset && (a.member_type.shares_value_with(b.member_type) || static_cast<const type &>(a.member_type) == b.member_type); }
+bool spvi::operator == (const type::structure & a, const type::structure & b) { return a.name == b.name && a.members == b.members; }
+bool spvi::operator == (const type::image & a, const type::image & b) { return std::tie(a.channel_kind, a.view_type, a.is_multisampled, a.is_shadow, a.is_storage, a.format) == std::tie(b.channel_kind, b.view_type, b.is_multisampled, b.is_shadow, b.is_storage, b.format); }
+bool spvi::operator == (const type & a, const type & b) { return a.contents == b.contents; }
+
+uint64_t spvi::hash_type(const type & t)
+{
+    if(auto * s = std::get_if<type::sampler>(&t.contents)) return hash_sampler(*s);
+    if(auto * x = std::get_if<type::numeric>(&t.contents)) return hash_numeric(*x);
+    if(auto * i = std::get_if<type::image>(&t.contents)) return hash_image(*i);
+    if(std::holds_alternative<type::separate_sampler>(t.contents)) return hash_separate_sampler();
+    if(auto * a = std::get_if<type::array>(&t.contents)) return hash_array(hash_type(a->elem_type), a->elem_count, a->stride, a->elem_count_expression);
+    auto & s = std::get<type::structure>(t.contents);
+    uint64_t h = hash_structure(s.name.c_str(), s.members.size());
+    for(auto & m : s.members) h = hash_member(h, m.name.c_str(), hash_type(m.member_type), m.offset);
+    return h;
+}
+
+namespace
+{
+    // Adds the time since the previous phase ended to a counter of a profile, and does nothing if there is no profile
+    class phase_timer
+    {
+        spvi::reflection_profile * profile;
+        std::chrono::steady_clock::time_point phase_start;
+    public:
+        phase_timer(spvi::reflection_profile * profile) : profile{profile} { if(profile) phase_start = std::chrono::steady_clock::now(); }
+
+        void end_phase(uint64_t spvi::reflection_profile::* counter)
+        {
+            if(!profile) return;
+            const auto now = std::chrono::steady_clock::now();
+            profile->*counter += std::chrono::duration_cast<std::chrono::nanoseconds>(now - phase_start).count();
+            phase_start = now;
+        }
+    };
+
+    template<class T> size_t get_capacity_bytes(const std::vector<T> & v) { return v.capacity() * sizeof(T); }
+
+    size_t get_capacity_bytes(const spvi::type_graph & graph) { return get_capacity_bytes(graph.types) + get_capacity_bytes(graph.members) + get_capacity_bytes(graph.strings); }
+
+    size_t get_capacity_bytes(const spvi::flat_module_interface & info)
+    {
+        return get_capacity_bytes(info.variables) + get_capacity_bytes(info.descriptor_sets) + get_capacity_bytes(info.push_constants) + get_capacity_bytes(info.entry_points)
+            + get_capacity_bytes(info.specialization_constants) + get_capacity_bytes(info.specialization_program);
+    }
+
+    // Converts the declarations of a loaded module into the interface of a flat_module_info, interning its types into the graph of the given builder.
+    // Failures which are not tied to a single instruction are attributed to the declaration being converted, so that try_reflect_flat can still
+    // report where they occurred.
+    reflection_failure convert_module(const module & mod, type_graph_builder & builder, spvi::flat_module_interface & info, spvi::reflection_profile * profile)
+    {
+        const spvi::type_graph & graph = builder.get_graph();
+        const size_t first_type = graph.types.size(), graph_bytes = get_capacity_bytes(graph);
+        specialization_compiler specialization {mod, info.specialization_constants, info.specialization_program};
+        type_converter converter {mod, builder, specialization};
+        if(auto failure = specialization.reflect_constants(builder)) return failure;
+
+        auto convert_variable = [&](const instruction & inst, uint32_t index, spvi::flat_variable_info & v) -> reflection_failure
+        {
+            const instruction * type_inst, * pointee_inst;
+            if(auto failure = mod.get_instruction(inst.id(0), type_inst)) return failure;
+            if(type_inst->op_code != spv::Op::OpTypePointer) return {errc::invalid_module, "variable type is not a pointer", inst.first};
+            if(auto failure = mod.get_instruction(type_inst->id(0), pointee_inst)) return failure;
+            v = {index, 0, builder.intern_string(mod.get_name(inst.result_id)), VK_DESCRIPTOR_TYPE_MAX_ENUM};
+            return converter.convert(*pointee_inst, 0, false, v.type);
+        };
+
+        // The kind of descriptor is determined by the innermost type of any array of descriptors, and by the storage class for buffers
+        auto get_descriptor_type = [&](const instruction & inst, VkDescriptorType & descriptor_type) -> reflection_failure
+        {
+            const instruction * type_inst;
+            if(auto failure = mod.get_instruction(inst.id(0), type_inst)) return failure;
+            if(auto failure = mod.get_instruction(type_inst->id(0), type_inst)) return failure;
+            while(type_inst->op_code == spv::Op::OpTypeArray || type_inst->op_code == spv::Op::OpTypeRuntimeArray)
+            {
+                if(auto failure = mod.get_instruction(type_inst->id(0), type_inst)) return failure;
+            }
+            switch(type_inst->op_code)
+            {
+            case spv::Op::OpTypeSampledImage: descriptor_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER; break;
+            case spv::Op::OpTypeImage: descriptor_type = type_inst->num(3) == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE; break;
+            case spv::Op::OpTypeSampler: descriptor_type = VK_DESCRIPTOR_TYPE_SAMPLER; break;
+            case spv::Op::OpTypeStruct: // Older modules declare storage buffers as Uniform blocks with the BufferBlock decoration
+                descriptor_type = inst.storage_class() == spv::StorageClass::StorageBuffer || mod.has_decoration(type_inst->result_id, spv::Decoration::BufferBlock) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; 
+                break;
+            default: return {errc::unsupported, "unsupported descriptor type", inst.first};
+            }
+            return {errc::success, nullptr, nullptr};
+        };
+
+        std::vector<std::pair<uint32_t, spvi::flat_variable_info>> descriptors;
+        auto convert_declaration = [&](const instruction & inst) -> reflection_failure
+        {
+            // Uniform and storage blocks have storage class Uniform or StorageBuffer, while images and samplers have storage class UniformConstant
+            if(inst.op_code == spv::Op::OpVariable && (inst.storage_class() == spv::StorageClass::Uniform || inst.storage_class() == spv::StorageClass::UniformConstant || inst.storage_class() == spv::StorageClass::StorageBuffer))
+            {
+                uint32_t set, binding;
+                if(!mod.get_decoration(inst.result_id, spv::Decoration::DescriptorSet, set)) return {errc::invalid_module, "missing set qualifier", inst.first};
+                if(!mod.get_decoration(inst.result_id, spv::Decoration::Binding, binding)) return {errc::invalid_module, "missing binding qualifier", inst.first};
+                spvi::flat_variable_info v;
+                if(auto failure = convert_variable(inst, binding, v)) return failure;
+                if(auto failure = get_descriptor_type(inst, v.descriptor_type)) return failure;
+                descriptors.push_back({set, v});
+            }
+
+            if(inst.op_code == spv::Op::OpVariable && inst.storage_class() == spv::StorageClass::PushConstant)
+            {
+                spvi::flat_variable_info v;
+                if(auto failure = convert_variable(inst, 0, v)) return failure;
+                info.push_constants.push_back(v);
+            }
+
+            if(inst.op_code == spv::Op::OpEntryPoint)
+            {
+                spvi::flat_entry_point_info e;
+                switch(inst.execution_model())
+                {
+                case spv::ExecutionModel::Vertex: e.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+                case spv::ExecutionModel::TessellationControl: e.stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; break;
+                case spv::ExecutionModel::TessellationEvaluation: e.stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT; break;
+                case spv::ExecutionModel::Geometry: e.stage = VK_SHADER_STAGE_GEOMETRY_BIT; break;
+                case spv::ExecutionModel::Fragment: e.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+                case spv::ExecutionModel::GLCompute: e.stage = VK_SHADER_STAGE_COMPUTE_BIT; break;
+                default: return {errc::unsupported, "bad ExecutionModel", inst.first};
+                }
+                e.name = builder.intern_string(inst.string());
+
+                std::vector<spvi::flat_variable_info> inputs, outputs;
+                for(auto id : inst.var_ids())
+                {
+                    // Skip over inputs/outputs without an explicit location (such as the BuiltIn block)
+                    uint32_t location;
+                    if(!mod.get_decoration(id, spv::Decoration::Location, location)) continue;
+
+                    const instruction * iface;
+                    spvi::flat_variable_info v;
+                    if(auto failure = mod.get_instruction(id, iface)) return failure;
+                    if(iface->op_code != spv::Op::OpVariable) return {errc::invalid_module, "interface is not a variable", iface->first};
+                    if(iface->storage_class() != spv::StorageClass::Input && iface->storage_class() != spv::StorageClass::Output) return {errc::invalid_module, "bad storage class", iface->first};
+                    if(auto failure = convert_variable(*iface, location, v)) return failure;
+                    (iface->storage_class() == spv::StorageClass::Input ? inputs : outputs).push_back(v);
+                }
+
+                auto by_index = [](auto & l, auto & r) { return l.index < r.index; };
+                std::sort(begin(inputs), end(inputs), by_index);
+                std::sort(begin(outputs), end(outputs), by_index);
+                e.first_input = static_cast<uint32_t>(info.variables.size());
+                e.input_count = static_cast<uint32_t>(inputs.size());
+                info.variables.insert(end(info.variables), begin(inputs), end(inputs));
+                e.first_output = static_cast<uint32_t>(info.variables.size());
+                e.output_count = static_cast<uint32_t>(outputs.size());
+                info.variables.insert(end(info.variables), begin(outputs), end(outputs));
+                info.entry_points.push_back(e);
+            }
+            return {errc::success, nullptr, nullptr};
+        };
+
+        for(const auto & inst : mod.instructions)
+        {
+            if(auto failure = convert_declaration(inst)) return {failure.code, failure.message, failure.word ? failure.word : inst.first};
+        }
+
+        // Descriptors are grouped into sets, with both sets and descriptors ordered by index
+        std::sort(begin(descriptors), end(descriptors), [](auto & l, auto & r) { return std::tie(l.first, l.second.index) < std::tie(r.first, r.second.index); });
+        for(auto & d : descriptors)
+        {
+            if(info.descriptor_sets.empty() || info.descriptor_sets.back().set != d.first) info.descriptor_sets.push_back({d.first, static_cast<uint32_t>(info.variables.size()), 0});
+            info.variables.push_back(d.second);
+            ++info.descriptor_sets.back().descriptor_count;
+        }
+
+        std::sort(begin(info.entry_points), end(info.entry_points), [&](auto & l, auto & r) { return l.stage != r.stage ? l.stage < r.stage : strcmp(graph.get_string(l.name), graph.get_string(r.name)) < 0; });
+
+        // Everything counted here is already known once conversion is complete, so reflection without a profile does no extra work
+        if(!profile) return {errc::success, nullptr, nullptr};
+        profile->op_code_counts.resize(std::max(profile->op_code_counts.size(), op_code_count));
+        for(auto & inst : mod.instructions) ++profile->op_code_counts[static_cast<size_t>(inst.op_code)];
+        profile->type_conversions += converter.get_conversion_count();
+        profile->interned_types += graph.types.size() - first_type;
+        profile->bytes_allocated += mod.get_capacity_bytes() + get_capacity_bytes(info) + get_capacity_bytes(graph) - graph_bytes;
+        profile->id_lookups += mod.id_lookups.count;
+        profile->name_lookups += mod.name_lookups.count;
+        profile->decoration_lookups += mod.decoration_lookups.count;
+        profile->type_cache_hits += converter.cache_hits.count;
+        return {errc::success, nullptr, nullptr};
+    }
+
+    // Counts a binary whose declarations have been converted
+    void count_module(spvi::reflection_profile * profile, const module & mod, size_t word_count)
+    {
+        if(!profile) return;
+        ++profile->module_count;
+        profile->word_count += word_count;
+        profile->skipped_words += word_count - mod.declarations_end;
+    }
+}
+
+spvi::flat_module_info::flat_module_info(const uint32_t * words, size_t word_count, reflection_profile * profile)
+{
+    phase_timer timer {profile};
+    module mod = load_module(words, word_count, load_mode::declarations_only);
+    timer.end_phase(&reflection_profile::load_nanoseconds);
+    type_graph_builder builder {types};
+    if(auto failure = convert_module(mod, builder, *this, profile)) throw reflection_exception<std::logic_error>{failure.code, failure.message, failure.word};
+    timer.end_phase(&reflection_profile::convert_nanoseconds);
+    count_module(profile, mod, word_count);
+}
+
+spvi::module_info::module_info(const uint32_t * words, size_t word_count, reflection_profile * profile) : module_info{flat_module_info{words, word_count, profile}, profile} {}
+
+spvi::expected<spvi::flat_module_info> spvi::try_reflect_flat(const uint32_t * words, size_t word_count) noexcept
+{
+    auto get_error = [&](const reflection_failure & f) -> reflection_error
+    {
+        return {f.code, f.word ? static_cast<size_t>(f.word - words) : reflection_error::unknown_offset, f.message};
+    };
+    // Every failure is returned as a value, so only allocation failures can unwind to here
+    try
+    {
+        module mod;
+        if(auto failure = load_module(words, word_count, load_mode::declarations_only, mod)) return get_error(failure);
+        flat_module_info info;
+        type_graph_builder builder {info.types};
+        if(auto failure = convert_module(mod, builder, info, nullptr)) return get_error(failure);
+        return info;
+    }
+    catch(...) { return reflection_error{reflection_errc::out_of_memory, reflection_error::unknown_offset, "out of memory"}; }
+}
+
+spvi::expected<spvi::module_info> spvi::try_reflect(const uint32_t * words, size_t word_count) noexcept
+{
+    auto flat = try_reflect_flat(words, word_count);
+    if(!flat) return flat.error();
+    try { return module_info{*flat}; }
+    catch(...) { return reflection_error{reflection_errc::out_of_memory, reflection_error::unknown_offset, "out of memory"}; }
+}
+
+namespace
+{
+    // Interns the types of module_info trees into a type_graph, converting each node only once even when it is shared by several trees
+    class tree_interner
+    {
+        type_graph_builder & builder;
+        std::unordered_map<const spvi::type *, spvi::type_graph::type_index> converted;
+    public:
+        tree_interner(type_graph_builder & builder) : builder{builder} {}
+
+        spvi::type_graph::type_index intern(const spvi::type & t)
+        {
+            auto it = converted.find(&t);
+            if(it != converted.end()) return it->second;
+
+            spvi::type_graph::type_index index;
+            if(auto * s = std::get_if<spvi::type::structure>(&t.contents))
+            {
+                std::vector<spvi::type_graph::member> members;
+                members.reserve(s->members.size());
+                for(auto & m : s->members) members.push_back({builder.intern_string(m.name.c_str()), intern(m.member_type), m.offset});
+                index = builder.intern_structure(builder.intern_string(s->name.c_str()), members);
+            }
+            else if(auto * a = std::get_if<spvi::type::array>(&t.contents)) index = builder.intern_type({spvi::type_graph::array{intern(a->elem_type), a->elem_count, a->stride, a->elem_count_expression}});
+            else if(auto * x = std::get_if<spvi::type::sampler>(&t.contents)) index = builder.intern_type({*x});
+            else if(auto * x = std::get_if<spvi::type::numeric>(&t.contents)) index = builder.intern_type({*x});
+            else if(auto * x = std::get_if<spvi::type::image>(&t.contents)) index = builder.intern_type({*x});
+            else index = builder.intern_type({spvi::type::separate_sampler{}});
+
+            converted.emplace(&t, index);
+            return index;
+        }
+    };
+}
+
+spvi::flat_module_info::flat_module_info(const module_info & info)
+{
+    type_graph_builder builder {types};
+    tree_interner interner {builder};
+    auto add_variables = [&](const std::vector<variable_info> & from)
+    {
+        const auto first = static_cast<uint32_t>(variables.size());
+        for(auto & v : from) variables.push_back({v.index, interner.intern(v.type), builder.intern_string(v.name.c_str()), v.descriptor_type});
+        return first;
+    };
+    for(auto & set : info.descriptor_sets) descriptor_sets.push_back({set.set, add_variables(set.descriptors), static_cast<uint32_t>(set.descriptors.size())});
+    for(auto & p : info.push_constants) push_constants.push_back({p.index, interner.intern(p.type), builder.intern_string(p.name.c_str()), p.descriptor_type});
+    for(auto & e : info.entry_points)
+    {
+        const uint32_t first_input = add_variables(e.inputs), first_output = add_variables(e.outputs);
+        entry_points.push_back({e.stage, first_input, static_cast<uint32_t>(e.inputs.size()), first_output, static_cast<uint32_t>(e.outputs.size()), builder.intern_string(e.name.c_str())});
+    }
+    for(auto & c : info.specialization_constants) specialization_constants.push_back({c.constant_id, builder.intern_string(c.name.c_str()), c.elem_kind, c.elem_width, c.is_bool, c.default_value});
+    specialization_program = info.specialization_program;
+}
+
+spvi::module_info::module_info(const flat_module_info & flat, reflection_profile * profile)
+{
+    phase_timer timer {profile};
+    const auto types = flat.types.get_types();
+    auto get_variables = [&](uint32_t first, uint32_t count)
+    {
+        std::vector<variable_info> variables;
+        variables.reserve(count);
+        for(uint32_t i=0; i<count; ++i)
+        {
+            auto & v = flat.variables[first + i];
+            variables.push_back({v.index, types[v.type], flat.types.get_string(v.name), v.descriptor_type});
+        }
+        return variables;
+    };
+    for(auto & set : flat.descriptor_sets) descriptor_sets.push_back({set.set, get_variables(set.first_descriptor, set.descriptor_count)});
+    for(auto & p : flat.push_constants) push_constants.push_back({p.index, types[p.type], flat.types.get_string(p.name), p.descriptor_type});
+    for(auto & e : flat.entry_points) entry_points.push_back({e.stage, get_variables(e.first_input, e.input_count), get_variables(e.first_output, e.output_count), flat.types.get_string(e.name)});
+    for(auto & c : flat.specialization_constants) specialization_constants.push_back({c.constant_id, flat.types.get_string(c.name), c.elem_kind, c.elem_width, c.is_bool, c.default_value});
+    specialization_program = flat.specialization_program;
+    timer.end_phase(&reflection_profile::tree_nanoseconds);
+    if(profile) profile->tree_types += types.size();
+}
+
+/////////////////////
+// Module families //
+/////////////////////
+
+namespace
+{
+    // Copies the types and names which a module refers to out of a shared type_graph, interning them again so that the copy matches a graph of its own
+    class graph_copier
+    {
+        const spvi::type_graph & from;
+        type_graph_builder builder;
+        std::unordered_map<spvi::type_graph::type_index, spvi::type_graph::type_index> types;
+        std::unordered_map<spvi::type_graph::string_index, spvi::type_graph::string_index> strings;
+    public:
+        graph_copier(const spvi::type_graph & from, spvi::type_graph & to) : from{from}, builder{to} {}
+
+        spvi::type_graph::string_index copy_string(spvi::type_graph::string_index index)
+        {
+            auto it = strings.find(index);
+            return it != strings.end() ? it->second : strings[index] = builder.intern_string(from.get_string(index));
+        }
+
+        spvi::type_graph::type_index copy_type(spvi::type_graph::type_index index)
+        {
+            auto it = types.find(index);
+            if(it != types.end()) return it->second;
+
+            auto & n = from.types[index];
+            spvi::type_graph::type_index r;
+            if(auto * s = std::get_if<spvi::type_graph::structure>(&n.contents))
+            {
+                std::vector<spvi::type_graph::member> members;
+                members.reserve(s->member_count);
+                for(uint32_t i=0; i<s->member_count; ++i)
+                {
+                    auto & m = from.members[s->first_member + i];
+                    members.push_back({copy_string(m.name), copy_type(m.member_type), m.offset});
+                }
+                r = builder.intern_structure(copy_string(s->name), members);
+            }
+            else if(auto * a = std::get_if<spvi::type_graph::array>(&n.contents)) r = builder.intern_type({spvi::type_graph::array{copy_type(a->elem_type), a->elem_count, a->stride, a->elem_count_expression}});
+            else r = builder.intern_type({n.contents});
+            return types[index] = r;
+        }
+
+        void copy_variables(std::vector<spvi::flat_variable_info> & variables) { for(auto & v : variables) { v.type = copy_type(v.type); v.name = copy_string(v.name); } }
+    };
+
+    // Measures the type graph which a module would have on its own, which holds every type and name the module refers to, directly or through other types
+    size_t measure_unshared_bytes(const spvi::type_graph & graph, const spvi::flat_module_interface & info)
+    {
+        std::unordered_set<spvi::type_graph::type_index> types;
+        std::unordered_set<spvi::type_graph::string_index> strings;
+        std::vector<spvi::type_graph::type_index> unvisited;
+        size_t member_count = 0, string_bytes = 0;
+        auto visit_string = [&](spvi::type_graph::string_index s) { if(strings.insert(s).second) string_bytes += strlen(graph.get_string(s)) + 1; };
+        auto visit_type = [&](spvi::type_graph::type_index t) { if(types.insert(t).second) unvisited.push_back(t); };
+        for(auto * variables : {&info.variables, &info.push_constants}) for(auto & v : *variables) { visit_type(v.type); visit_string(v.name); }
+        for(auto & e : info.entry_points) visit_string(e.name);
+        for(auto & c : info.specialization_constants) visit_string(c.name);
+        while(!unvisited.empty())
+        {
+            auto & n = graph.types[unvisited.back()];
+            unvisited.pop_back();
+            if(auto * a = std::get_if<spvi::type_graph::array>(&n.contents)) visit_type(a->elem_type);
+            if(auto * s = std::get_if<spvi::type_graph::structure>(&n.contents))
+            {
+                visit_string(s->name);
+                member_count += s->member_count;
+                for(uint32_t i=0; i<s->member_count; ++i)
+                {
+                    visit_string(graph.members[s->first_member + i].name);
+                    visit_type(graph.members[s->first_member + i].member_type);
+                }
+            }
+        }
+        return types.size() * sizeof(spvi::type_graph::node) + member_count * sizeof(spvi::type_graph::member) + string_bytes;
+    }
+}
+
+struct spvi::module_family::shared_types
+{
+    type_graph graph;
+    type_graph_builder builder {graph};
+};
+
+spvi::module_family::module_family() : shared{std::make_unique<shared_types>()} {}
+spvi::module_family::module_family(module_family && r) noexcept = default;
+spvi::module_family & spvi::module_family::operator = (module_family && r) noexcept = default;
+spvi::module_family::~module_family() = default;
+
+const spvi::type_graph & spvi::module_family::get_types() const { return shared->graph; }
+
+size_t spvi::module_family::add_module(const uint32_t * words, size_t word_count, reflection_profile * profile)
+{
+    phase_timer timer {profile};
+    module mod = load_module(words, word_count, load_mode::declarations_only);
+    timer.end_phase(&reflection_profile::load_nanoseconds);
+    flat_module_interface info;
+    if(auto failure = convert_module(mod, shared->builder, info, profile)) throw reflection_exception<std::logic_error>{failure.code, failure.message, failure.word};
+    timer.end_phase(&reflection_profile::convert_nanoseconds);
+    count_module(profile, mod, word_count);
+
+    unshared_bytes += measure_unshared_bytes(shared->graph, info);
+    modules.push_back(std::move(info));
+    return modules.size() - 1;
+}
+
+spvi::flat_module_info spvi::module_family::get_flat_module_info(size_t index) const
+{
+    flat_module_info r;
+    static_cast<flat_module_interface &>(r) = modules[index];
+    graph_copier copier {shared->graph, r.types};
+    copier.copy_variables(r.variables);
+    copier.copy_variables(r.push_constants);
+    for(auto & e : r.entry_points) e.name = copier.copy_string(e.name);
+    for(auto & c : r.specialization_constants) c.name = copier.copy_string(c.name);
+    return r;
+}
+
+spvi::family_memory_usage spvi::module_family::get_memory_usage() const
+{
+    family_memory_usage usage {get_capacity_bytes(shared->graph), get_capacity_bytes(modules), unshared_bytes};
+    for(auto & m : modules) usage.module_bytes += get_capacity_bytes(m);
+    return usage;
+}
+
+////////////////////
+// Specialization //
+////////////////////
+
+namespace
+{
+    size_t get_type_size(const spvi::type & t)
+    {
+        if(auto * x = std::get_if<spvi::type::numeric>(&t.contents)) return get_numeric_size(*x);
+        if(auto * a = std::get_if<spvi::type::array>(&t.contents)) return a->elem_count * (a->stride ? *a->stride : get_type_size(a->elem_type));
+        if(auto * s = std::get_if<spvi::type::structure>(&t.contents)) return s->size;
+        return 0;
+    }
+
+    // Rebuilds the types which depend on specialization constants, sharing every type which does not with the original module.
+    // Each shared node is only visited once, so that the cost is proportional to the number of distinct types rather than the size of the tree.
+    class type_specializer
+    {
+        const std::vector<uint64_t> & results;
+        std::unordered_map<const spvi::type *, std::optional<spvi::indirect<spvi::type>>> visited;
+
+        size_t get_result(uint32_t index) const { if(index >= results.size()) throw std::logic_error("bad specialization expression"); return static_cast<size_t>(results[index]); }
+    public:
+        type_specializer(const std::vector<uint64_t> & results) : results{results} {}
+
+        // Returns the specialized type, or std::nullopt if the type does not depend on any specialization constant
+        std::optional<spvi::indirect<spvi::type>> specialize(const spvi::indirect<spvi::type> & t)
+        {
+            const spvi::type & key = t;
+            auto it = visited.find(&key);
+            if(it != visited.end()) return it->second;
+            auto r = specialize(key);
+            return visited[&key] = r ? std::optional<spvi::indirect<spvi::type>>{std::move(*r)} : std::nullopt;
+        }
+
+        std::optional<spvi::type> specialize(const spvi::type & t)
+        {
+            if(auto * a = std::get_if<spvi::type::array>(&t.contents))
+            {
+                auto elem_type = specialize(a->elem_type);
+                const size_t elem_count = a->elem_count_expression ? get_result(*a->elem_count_expression) : a->elem_count;
+                if(!elem_type && elem_count == a->elem_count) return std::nullopt;
+                return spvi::type{spvi::type::array{elem_type ? *elem_type : a->elem_type, elem_count, a->stride, a->elem_count_expression}};
+            }
+            if(auto * s = std::get_if<spvi::type::structure>(&t.contents))
+            {
+                std::optional<spvi::type::structure> r;
+                for(size_t i=0; i<s->members.size(); ++i)
+                {
+                    auto member_type = specialize(s->members[i].member_type);
+                    if(!member_type) continue;
+                    if(!r) r = *s;
+                    r->members[i].size = get_type_size(*member_type);
+                    r->members[i].member_type = std::move(*member_type);
+                }
+                if(!r) return std::nullopt;
+
+                // Offsets are fixed by decorations, so only the size of the structure itself can change
+                r->size = 0;
+                for(auto & m : r->members) r->size = std::max(r->size, (m.offset ? *m.offset : r->size) + m.size);
+                return spvi::type{std::move(*r)};
+            }
+            return std::nullopt;
+        }
+
+        void specialize(std::vector<spvi::variable_info> & variables)
+        {
+            for(auto & v : variables) if(auto t = specialize(v.type)) v.type = std::move(*t);
+        }
+    };
+}
+
+spvi::module_info spvi::specialize(const module_info & info, const specialization_value * values, size_t value_count)
+{
+    module_info r {info};
+    if(info.specialization_program.empty()) return r;
+
+    const auto results = evaluate_program(info.specialization_program, get_constant_values(info.specialization_constants, values, value_count));
+    type_specializer specializer {results};
+    for(auto & set : r.descriptor_sets) specializer.specialize(set.descriptors);
+    specializer.specialize(r.push_constants);
+    for(auto & e : r.entry_points)
+    {
+        specializer.specialize(e.inputs);
+        specializer.specialize(e.outputs);
+    }
+    return r;
+}
+
+spvi::module_info spvi::specialize(const module_info & info, const VkSpecializationInfo & specialization_info)
+{
+    std::vector<specialization_value> values;
+    values.reserve(specialization_info.mapEntryCount);
+    for(uint32_t i=0; i<specialization_info.mapEntryCount; ++i)
+    {
+        // Values are little endian, and are zero extended from the size of their map entry
+        auto & entry = specialization_info.pMapEntries[i];
+        if(entry.size > sizeof(uint64_t) || entry.offset > specialization_info.dataSize || entry.size > specialization_info.dataSize - entry.offset) throw std::logic_error("specialization map entry out of bounds");
+        uint64_t value = 0;
+        memcpy(&value, static_cast<const uint8_t *>(specialization_info.pData) + entry.offset, entry.size);
+        values.push_back({entry.constantID, value});
+    }
+    return specialize(info, values);
+}
+
+spvi::flat_module_info spvi::specialize(const flat_module_info & info, const specialization_value * values, size_t value_count)
+{
+    flat_module_info r {info};
+    if(info.specialization_program.empty()) return r;
+
+    // Types only refer to types with lower indices, so the lengths, sizes and hashes of every type can be brought up to date in a single pass
+    const auto results = evaluate_program(info.specialization_program, get_constant_values(info.specialization_constants, values, value_count));
+    for(auto & n : r.types.types)
+    {
+        if(auto * a = std::get_if<type_graph::array>(&n.contents); a && a->elem_count_expression)
+        {
+            if(*a->elem_count_expression >= results.size()) throw std::logic_error("bad specialization expression");
+            a->elem_count = static_cast<size_t>(results[*a->elem_count_expression]);
+        }
+        n.hash = hash_node(r.types, n);
+        n.size = size_node(r.types, n);
+    }
+    return r;
+}
+
+///////////////
+// Stripping //
+///////////////
+
+namespace
+{
+    // Layouts of the declarations which strip_module can remove, but which reflection never decodes
+    constexpr op_code_info string_layout {part::result_id, part::string};
+    constexpr op_code_info type_function_layout {part::result_id, part::id_list};
+    constexpr op_code_info constant_composite_layout {{part::id,0}, part::result_id, part::id_list};
+    constexpr op_code_info constant_null_layout {{part::id,0}, part::result_id};
+
+    // Returns the layout of a declaration which can be removed once nothing refers to its result, or nullptr if the instruction must be kept
+    const op_code_info * find_removable_layout(spv::Op op_code)
+    {
+        switch(op_code)
+        {
+        case spv::Op::OpTypeVoid: case spv::Op::OpTypeBool: case spv::Op::OpTypeInt: case spv::Op::OpTypeFloat: case spv::Op::OpTypeVector: case spv::Op::OpTypeMatrix:
+        case spv::Op::OpTypeImage: case spv::Op::OpTypeSampler: case spv::Op::OpTypeSampledImage: case spv::Op::OpTypeArray: case spv::Op::OpTypeRuntimeArray:
+        case spv::Op::OpTypeStruct: case spv::Op::OpTypeOpaque: case spv::Op::OpTypePointer: case spv::Op::OpConstantTrue: case spv::Op::OpConstantFalse: case spv::Op::OpConstant:
+            return &op_code_infos[static_cast<size_t>(op_code)];
+        case spv::Op::OpString: return &string_layout;
+        case spv::Op::OpTypeFunction: return &type_function_layout;
+        case spv::Op::OpConstantComposite: return &constant_composite_layout;
+        case spv::Op::OpConstantNull: case spv::Op::OpUndef: return &constant_null_layout;
+        default: return nullptr;
+        }
+    }
+
+    // Debug information is removed unconditionally, as no other instruction may depend on it
+    bool is_debug_info(spv::Op op_code)
+    {
+        switch(op_code)
+        {
+        case spv::Op::OpSourceContinued: case spv::Op::OpSource: case spv::Op::OpSourceExtension: case spv::Op::OpName: case spv::Op::OpMemberName:
+        case spv::Op::OpLine: case spv::Op::OpNoLine: case spv::Op::OpModuleProcessed: return true;
+        default: return false;
+        }
+    }
+
+    // Decorations do not keep their target alive, and are removed along with it
+    bool is_decoration(spv::Op op_code) { return op_code == spv::Op::OpDecorate || op_code == spv::Op::OpMemberDecorate || op_code == spv::Op::OpDecorateId; }
+
+    // Calls f for each ID operand of an instruction with a known layout, other than its result
+    template<class F> void for_each_id_operand(const uint32_t * first, const op_code_info & layout, F f)
+    {
+        for_each_part(first, layout, [&](const part_info & p, const uint32_t * part_begin, const uint32_t * part_end)
+        {
+            if(p.p == part::id || p.p == part::optional_id || p.p == part::id_list) std::for_each(part_begin, part_end, f);
+            return false;
+        });
+    }
+
+    // As operator ==, but ignoring the names of structures and their members, which strip_module removes
+    bool same_layout(const spvi::type & a, const spvi::type & b)
+    {
+        if(auto * x = std::get_if<spvi::type::structure>(&a.contents))
+        {
+            auto * y = std::get_if<spvi::type::structure>(&b.contents);
+            return y && x->size == y->size && std::equal(x->members.begin(), x->members.end(), y->members.begin(), y->members.end(), [](const spvi::type::structure::member & m, const spvi::type::structure::member & n)
+            {
+                return m.offset == n.offset && m.size == n.size && same_layout(m.member_type, n.member_type);
+            });
+        }
+        if(auto * x = std::get_if<spvi::type::array>(&a.contents))
+        {
+            auto * y = std::get_if<spvi::type::array>(&b.contents);
+            return y && x->elem_count == y->elem_count && x->stride == y->stride && x->elem_count_expression == y->elem_count_expression && same_layout(x->elem_type, y->elem_type);
+        }
+        return a == b;
+    }
+
+    bool same_interface(const std::vector<spvi::variable_info> & a, const std::vector<spvi::variable_info> & b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const spvi::variable_info & x, const spvi::variable_info & y)
+        {
+            return x.index == y.index && x.descriptor_type == y.descriptor_type && same_layout(x.type, y.type);
+        });
+    }
+
+    // Compares everything which reflection reports apart from debug names. Entry point names are part of the interface, and are never stripped.
+    bool same_interface(const spvi::module_info & a, const spvi::module_info & b)
+    {
+        return same_interface(a.push_constants, b.push_constants)
+            && std::equal(a.descriptor_sets.begin(), a.descriptor_sets.end(), b.descriptor_sets.begin(), b.descriptor_sets.end(), [](const spvi::descriptor_set_info & x, const spvi::descriptor_set_info & y)
+            {
+                return x.set == y.set && same_interface(x.descriptors, y.descriptors);
+            })
+            && std::equal(a.entry_points.begin(), a.entry_points.end(), b.entry_points.begin(), b.entry_points.end(), [](const spvi::entry_point_info & x, const spvi::entry_point_info & y)
+            {
+                return x.stage == y.stage && x.name == y.name && same_interface(x.inputs, y.inputs) && same_interface(x.outputs, y.outputs);
+            })
+            && std::equal(a.specialization_constants.begin(), a.specialization_constants.end(), b.specialization_constants.begin(), b.specialization_constants.end(), [](const spvi::specialization_constant_info & x, const spvi::specialization_constant_info & y)
+            {
+                return x.constant_id == y.constant_id && x.elem_kind == y.elem_kind && x.elem_width == y.elem_width && x.is_bool == y.is_bool && x.default_value == y.default_value;
+            })
+            && std::equal(a.specialization_program.begin(), a.specialization_program.end(), b.specialization_program.begin(), b.specialization_program.end(), [](const spvi::specialization_op & x, const spvi::specialization_op & y)
+            {
+                return x.op == y.op && x.width == y.width && std::equal(std::begin(x.operands), std::end(x.operands), std::begin(y.operands)) && x.value == y.value;
+            });
+    }
+}
+
+spvi::stripped_module spvi::strip_module(const uint32_t * words, size_t word_count)
+{
+    // Reflection validates the header and the declarations, while the lengths of the instructions within function bodies are checked here
+    stripped_module r {module_info{words, word_count}, {}};
+    std::vector<uint32_t> offsets;
+    size_t end;
+    if(auto failure = scan_instructions(words, word_count, load_mode::whole_module, offsets, end)) throw reflection_exception<std::runtime_error>{failure.code, failure.message, failure.word};
+
+    // Count the references to each ID. Removable declarations are decoded exactly, while any word of any other instruction which could be an ID is counted
+    // as a reference to it. This overestimates the references from literals and function bodies, whose layouts are unknown, so nothing in use is removed.
+    const uint32_t bound = words[3];
+    std::vector<uint32_t> references(bound), definitions(bound, none);
+    for(size_t offset = 5; offset < word_count; offset += words[offset] >> 16)
+    {
+        const uint32_t * it = words + offset, * const inst_end = it + (*it >> 16);
+        const auto op_code = static_cast<spv::Op>(*it & spv::OpCodeMask);
+        if(is_debug_info(op_code)) continue;
+        if(is_decoration(op_code))
+        {
+            if(op_code == spv::Op::OpDecorateId) for(auto w = it + 3; w < inst_end; ++w) if(*w < bound) ++references[*w];
+            continue;
+        }
+        if(auto layout = find_removable_layout(op_code))
+        {
+            if(inst_end - it <= layout->result_word || it[layout->result_word] >= bound) throw reflection_exception<std::runtime_error>{errc::invalid_id, "bad id", it};
+            definitions[it[layout->result_word]] = static_cast<uint32_t>(offset);
+            for_each_id_operand(it, *layout, [&](uint32_t id) { if(id < bound) ++references[id]; });
+            continue;
+        }
+        for(auto w = it + 1; w < inst_end; ++w) if(*w < bound) ++references[*w];
+    }
+
+    // Removing a declaration releases its own references, which may leave further declarations unused
+    std::vector<bool> removed(bound);
+    std::vector<uint32_t> unused;
+    for(uint32_t id=0; id<bound; ++id) if(definitions[id] != none && references[id] == 0) unused.push_back(id);
+    while(!unused.empty())
+    {
+        const uint32_t id = unused.back();
+        unused.pop_back();
+        removed[id] = true;
+        const uint32_t * it = words + definitions[id];
+        for_each_id_operand(it, *find_removable_layout(static_cast<spv::Op>(*it & spv::OpCodeMask)), [&](uint32_t operand)
+        {
+            if(operand < bound && --references[operand] == 0 && definitions[operand] != none && !removed[operand]) unused.push_back(operand);
+        });
+    }
+
+    // IDs keep their numbers, as renumbering them would require the operand layout of every instruction which can appear in a function body
+    r.words.reserve(word_count);
+    r.words.insert(r.words.end(), words, words + 5);
+    for(size_t offset = 5; offset < word_count; offset += words[offset] >> 16)
+    {
+        const uint32_t * it = words + offset, * const inst_end = it + (*it >> 16);
+        const auto op_code = static_cast<spv::Op>(*it & spv::OpCodeMask);
+        if(is_debug_info(op_code)) continue;
+        if(is_decoration(op_code) && inst_end - it > 1 && it[1] < bound && removed[it[1]]) continue;
+        if(auto layout = find_removable_layout(op_code); layout && removed[it[layout->result_word]]) continue;
+        r.words.insert(r.words.end(), it, inst_end);
+    }
+
+    if(!same_interface(r.info, module_info{r.words})) throw std::logic_error("stripping changed the interface of the module");
+    return r;
+}
+
+/////////////////////////
+// Incremental parsing //
+/////////////////////////
+
+void spvi::module_parser::feed(const uint32_t * chunk, size_t word_count)
+{
+    const uint32_t * it = chunk, * chunk_end = chunk + word_count;
+    while(it != chunk_end && !complete)
+    {
+        // Fill in the header, and check the magic number as soon as it arrives, so that streams of some other format are rejected early
+        if(words.size() < 5)
+        {
+            const size_t n = std::min<size_t>(5 - words.size(), chunk_end - it);
+            if(words.empty() && *it != 0x07230203) throw std::runtime_error("not SPIR-V");
+            words.insert(words.end(), it, it + n);
+            it += n;
+            continue;
+        }
+
+        // Continue any instruction which straddles the boundary between chunks
+        if(retained_words || skipped_words)
+        {
+            const size_t n = std::min<size_t>(retained_words + skipped_words, chunk_end - it);
+            if(retained_words) { words.insert(words.end(), it, it + n); retained_words -= n; }
+            else skipped_words -= n;
+            it += n;
+            continue;
+        }
+
+        // Otherwise we are at the start of an instruction, so decide whether to keep it, skip it, or stop
+        const uint32_t op_code_length = *it >> 16;
+        if(op_code_length == 0) throw std::runtime_error("invalid opcode length");
+        const auto op_code = static_cast<spv::Op>(*it & spv::OpCodeMask);
+        if(op_code == spv::Op::OpFunction) complete = true;
+        else if(find_op_code_info(static_cast<uint32_t>(op_code))) retained_words = op_code_length;
+        else skipped_words = op_code_length;
+    }
+}
+
+spvi::flat_module_info spvi::module_parser::finish_flat() const
+{
+    if(retained_words || skipped_words) throw std::runtime_error("incomplete opcode");
+    return flat_module_info{words};
+}
+
+/////////////////////////
+// Parallel reflection //
+/////////////////////////
+
+namespace
+{
+    // A range of task indices owned by one worker thread
+    struct work_range
+    {
+        std::mutex mutex;
+        size_t begin, end;
+    };
+
+    // Calls f(i) for every i in [0, count) across a set of threads, including the calling thread. Each worker starts with an
+    // equal share of the indices, which it consumes from the front. When a worker runs out, it steals the back half of the 
+    // range of another worker, so that threads which draw expensive modules do not hold up the batch.
+    template<class F> void parallel_for(size_t count, size_t thread_count, F f)
+    {
+        std::unique_ptr<work_range[]> ranges {new work_range[thread_count]};
+        for(size_t i=0; i<thread_count; ++i)
+        {
+            ranges[i].begin = count * i / thread_count;
+            ranges[i].end = count * (i+1) / thread_count;
+        }
+
+        auto steal = [&](size_t thief)
+        {
+            for(size_t i=1; i<thread_count; ++i)
+            {
+                work_range & victim = ranges[(thief + i) % thread_count];
+                size_t begin, end;
+                {
+                    std::lock_guard<std::mutex> lock {victim.mutex};
+                    if(victim.begin == victim.end) continue;
+                    end = victim.end;
+                    begin = victim.end -= (victim.end - victim.begin + 1) / 2;
+                }
+                std::lock_guard<std::mutex> lock {ranges[thief].mutex};
+                ranges[thief].begin = begin;
+                ranges[thief].end = end;
+                return true;
+            }
+            return false;
+        };
+
+        auto work = [&](size_t worker)
+        {
+            work_range & own = ranges[worker];
+            while(true)
+            {
+                size_t index = count;
+                {
+                    std::lock_guard<std::mutex> lock {own.mutex};
+                    if(own.begin != own.end) index = own.begin++;
+                }
+                if(index != count) f(index);
+                else if(!steal(worker)) return;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(size_t i=1; i<thread_count; ++i) threads.emplace_back(work, i);
+        work(0);
+        for(auto & t : threads) t.join();
+    }
+}
+
+std::vector<spvi::reflection_result> spvi::reflect_many(const binary_view * binaries, size_t binary_count, size_t thread_count)
+{
+    if(thread_count == 0) thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    thread_count = std::max<size_t>(std::min(thread_count, binary_count), 1);
+
+    std::vector<reflection_result> results(binary_count);
+    parallel_for(binary_count, thread_count, [&](size_t i)
+    {
+        auto r = try_reflect(binaries[i].words, binaries[i].word_count);
+        if(r) results[i].info.emplace(std::move(*r));
+        else
+        {
+            results[i].error = r.error().message;
+            results[i].error_code = r.error().code;
+        }
+    });
+    return results;
 }
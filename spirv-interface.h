@@ -1,6 +1,7 @@
 #pragma once
 #include <vulkan/vulkan.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -9,24 +10,36 @@
 
 namespace spvi
 {
-    // Value type that simply models a value of type T, but allocates on the heap, useful for breaking cycles in recursive variants
+    // Value type that simply models a value of type T, but allocates on the heap, useful for breaking cycles in recursive variants.
+    // Copies share the same allocation until one of them is modified, so that large trees of types can be copied cheaply. Reading never
+    // copies, while modify() unshares the value first. The reference it returns is only valid until this object is next copied or assigned.
     template<class T> class indirect
     {
-        std::unique_ptr<T> value;
+        std::shared_ptr<T> value;
+
+        T & unique()
+        {
+            if(value.use_count() != 1) value = std::make_shared<T>(*value);
+            else std::atomic_thread_fence(std::memory_order_acquire); // Synchronize with the release of any copy which was destroyed on another thread
+            return *value;
+        }
     public:
-        indirect() : value{new T} {}
-        indirect(T && r) : value{new T{std::move(r)}} {}
-        indirect(const T & r) : value{new T{r}} {}
-        indirect(indirect && r) : value{new T{}} { *value = std::move(*r.value); }
-        indirect(const indirect & r) : value{new T{*r.value}} {}
+        indirect() : value{std::make_shared<T>()} {}
+        indirect(T && r) : value{std::make_shared<T>(std::move(r))} {}
+        indirect(const T & r) : value{std::make_shared<T>(r)} {}
+        indirect(indirect && r) : value{std::move(r.value)} {} // Takes ownership of r's value without allocating, afterwards r may only be assigned to or destroyed
+        indirect(const indirect & r) : value{r.value} {}
 
         operator const T & () const { return *value; }
+        T & modify() { return unique(); }
+
+        indirect & operator = (T && r) { if(value.use_count() == 1) unique() = std::move(r); else value = std::make_shared<T>(std::move(r)); return *this; }
+        indirect & operator = (const T & r) { if(value.use_count() == 1) unique() = r; else value = std::make_shared<T>(r); return *this; }
+        indirect & operator = (indirect && r) { value.swap(r.value); return *this; }
+        indirect & operator = (const indirect & r) { value = r.value; return *this; }
 
-        operator T & () { return *value; }
-        indirect & operator = (T && r) { *value = std::move(r); return *this; }
-        indirect & operator = (const T & r) { *value = r; return *this; }
-        indirect & operator = (indirect && r) { *value = std::move(*r.value); return *this; }
-        indirect & operator = (const indirect & r) { *value = *r.value; return *this; }       
+        // True if both objects share the same allocation, and therefore the same value
+        bool shares_value_with(const indirect & r) const { return value == r.value; }
     };
 
     // The type of an input, output, or uniform
@@ -50,15 +63,16 @@ namespace spvi
             number_kind elem_kind; 
             size_t elem_width;
             size_t row_count, column_count;
-            size_t row_stride, column_stride; // TODO: Should these be optional?
+            size_t row_stride, column_stride; // Bytes between consecutive rows and columns, where the MatrixStride of a row-major matrix is its row_stride, see is_row_major
         };
 
-        // A fixed-length array type
+        // An array type, either of fixed length, or a runtime array whose length is determined by the size of the buffer it is stored in
         struct array
         {
             indirect<type> elem_type;
-            size_t elem_count;
+            size_t elem_count;      // Zero for runtime arrays
             std::optional<size_t> stride;
+            std::optional<uint32_t> elem_count_expression; // For arrays sized by specialization constants, the index of the operation within module_info::specialization_program which computes elem_count
         };
 
         // A struct type
@@ -69,21 +83,120 @@ namespace spvi
                 std::string name;
                 indirect<type> member_type;
                 std::optional<size_t> offset;
+                size_t size = 0;    // Size in bytes of the member, see type_graph::node::size
             };
 
             std::string name;
             std::vector<member> members;
+            size_t size = 0;        // Size in bytes of the structure, from its start to the end of its last member
         };
 
-        std::variant<sampler, numeric, array, structure> contents;
+        // An image which is accessed without a combined sampler, either a texture used with a separate sampler, or a storage image
+        struct image
+        {
+            number_kind channel_kind;
+            VkImageViewType view_type;
+            bool is_multisampled;
+            bool is_shadow;
+            bool is_storage;        // True for storage images, which are read and written directly rather than sampled
+            VkFormat format;        // The format declared for a storage image, or VK_FORMAT_UNDEFINED if the format is unknown
+        };
+
+        // A sampler which is not combined with an image
+        struct separate_sampler {};
+
+        std::variant<sampler, numeric, array, structure, image, separate_sampler> contents;
     };
 
-    // The metadata for a single uniform, input or output
+    // Structural equality of types, comparing names, offsets, and strides as well as shape
+    bool operator == (const type::sampler & a, const type::sampler & b);
+    bool operator == (const type::numeric & a, const type::numeric & b);
+    bool operator == (const type::array & a, const type::array & b);
+    bool operator == (const type::structure::member & a, const type::structure::member & b);
+    bool operator == (const type::structure & a, const type::structure & b);
+    bool operator == (const type::image & a, const type::image & b);
+    inline bool operator == (const type::separate_sampler &, const type::separate_sampler &) { return true; }
+    bool operator == (const type & a, const type & b);
+    inline bool operator != (const type::sampler & a, const type::sampler & b) { return !(a == b); }
+    inline bool operator != (const type::numeric & a, const type::numeric & b) { return !(a == b); }
+    inline bool operator != (const type::array & a, const type::array & b) { return !(a == b); }
+    inline bool operator != (const type::structure::member & a, const type::structure::member & b) { return !(a == b); }
+    inline bool operator != (const type::structure & a, const type::structure & b) { return !(a == b); }
+    inline bool operator != (const type::image & a, const type::image & b) { return !(a == b); }
+    inline bool operator != (const type::separate_sampler &, const type::separate_sampler &) { return false; }
+    inline bool operator != (const type & a, const type & b) { return !(a == b); }
+
+    // Structural hash of a type, consistent with operator ==. The result does not depend on the platform or on the module the type came from,
+    // and is equal to the hash which a type_graph stores for the same type, so layouts can be matched across modules by comparing hashes.
+    uint64_t hash_type(const type & t);
+
+    // Mixes a value into a hash, as used by hash_type, for hashes of other structures that must also be stable across platforms
+    uint64_t hash_combine(uint64_t seed, uint64_t value);
+
+    // Size in bytes of a scalar, vector or matrix according to its explicit layout
+    size_t get_numeric_size(const type::numeric & x);
+
+    // True for matrices declared with the RowMajor decoration, whose rows rather than columns are contiguous in memory
+    bool is_row_major(const type::numeric & x);
+
+    // A graph of types stored in a few contiguous arrays, as an alternative to the tree of individually allocated nodes formed by spvi::type.
+    // Types refer to one another by index, names are interned into a single string pool, and identical types are only stored once, 
+    // so types which are structurally equal within the same graph always have the same index. Arrays sized by specialization constants are only
+    // equal if they are sized by the same elem_count_expression, so after specialize, arrays whose different expressions evaluate to the same
+    // length keep their separate indices. Types only ever refer to types with a lower index.
+    struct type_graph
+    {
+        typedef uint32_t type_index;    // Index into types
+        typedef uint32_t string_index;  // Offset of a null terminated string within strings
+
+        struct array
+        {
+            type_index elem_type;
+            size_t elem_count;
+            std::optional<size_t> stride;
+            std::optional<uint32_t> elem_count_expression;
+        };
+
+        struct structure
+        {
+            string_index name;
+            uint32_t first_member, member_count; // Range within members
+        };
+
+        struct member
+        {
+            string_index name;
+            type_index member_type;
+            std::optional<size_t> offset;
+        };
+
+        struct node
+        {
+            std::variant<type::sampler, type::numeric, array, structure, type::image, type::separate_sampler> contents;
+            uint64_t hash;  // Equal to hash_type(get_type(index)), so that types from different graphs can be compared in O(1)
+            size_t size;    // Size in bytes according to the explicit layout, which is zero for opaque types and runtime arrays, and for structures is measured up to the end of the last member
+        };
+
+        std::vector<node> types;
+        std::vector<member> members;
+        std::vector<char> strings;
+
+        const char * get_string(string_index index) const { return strings.data() + index; }
+
+        // Reconstructs the tree representation of a type
+        type get_type(type_index index) const;
+
+        // Reconstructs the tree representation of every type, indexed by type_index. Each node is converted only once, and is shared by every type which refers to it.
+        std::vector<indirect<type>> get_types() const;
+    };
+
+    // The metadata for a single uniform, push constant block, input or output
     struct variable_info
     {
-        uint32_t index;     // Binding index for a uniform within a descriptor set, or location index for a shader input/output
-        type type;
+        uint32_t index;     // Binding index for a uniform within a descriptor set, location index for a shader input/output, or zero for a push constant block
+        spvi::type type;   // Qualified so that GCC accepts a member which shares its name with its type
         std::string name;
+        VkDescriptorType descriptor_type = VK_DESCRIPTOR_TYPE_MAX_ENUM; // The kind of descriptor, for uniforms only
     };
 
     // The metadata for a single descriptor set
@@ -102,13 +215,319 @@ namespace spvi
         std::string name;
     };
 
+    // The metadata for a single specialization constant, whose value can be overridden when a pipeline is created
+    struct specialization_constant_info
+    {
+        uint32_t constant_id;       // The SpecId decoration, which is matched against VkSpecializationMapEntry::constantID
+        std::string name;           // Empty if the constant has no debug name
+        type::number_kind elem_kind;
+        size_t elem_width;          // Width in bits, which for booleans is the 32 bits of a VkBool32
+        bool is_bool;
+        uint64_t default_value;     // The bits of the value used when the constant is not specialized, zero extended to 64 bits
+    };
+
+    // A single operation of a program which computes integer values, such as array lengths, from specialization constants. Each operation
+    // refers only to the results of earlier operations, so the whole program can be evaluated in a single forward pass without the SPIR-V binary.
+    struct specialization_op
+    {
+        enum code : uint32_t
+        {
+            literal, constant, uconvert, sconvert, select,
+            negate, add, sub, mul, udiv, sdiv, umod, srem, smod,
+            shift_left, shift_right_logical, shift_right_arithmetic, bitwise_or, bitwise_xor, bitwise_and, bitwise_not,
+            logical_or, logical_and, logical_not, equal, not_equal, ult, slt, ule, sle, ugt, sgt, uge, sge,
+        };
+
+        code op;
+        uint32_t width;         // Width in bits of the result, which is stored zero extended, and is 1 for booleans
+        uint32_t operands[3];   // Indices of earlier operations, or for a constant, the index within specialization_constants
+        uint64_t value;         // The value of a literal
+    };
+
+    // A value for a specialization constant, with the same bits that VkSpecializationInfo would supply for it
+    struct specialization_value
+    {
+        uint32_t constant_id;
+        uint64_t value;
+    };
+
+    // Time spent in each phase of reflection, and counts of the work done in each, accumulated over every module reflected with the same profile.
+    // Reflecting without a profile does none of this bookkeeping. The lookup counters would cost an increment on the hottest paths of reflection,
+    // so they are only maintained when the library is built with SPVI_COUNT_LOOKUPS defined as 1, and otherwise remain zero.
+    struct reflection_profile
+    {
+        uint64_t load_nanoseconds = 0;      // Validating the binary and indexing its instructions by ID
+        uint64_t convert_nanoseconds = 0;   // Converting types and variables into a flat_module_info
+        uint64_t tree_nanoseconds = 0;      // Building the tree of types of a module_info from a flat_module_info
+        uint64_t module_count = 0;
+
+        uint64_t word_count = 0;                // Words in the binaries, including function bodies
+        uint64_t skipped_words = 0;             // Words from the first function definition onwards, which are never scanned
+        std::vector<uint64_t> op_code_counts;   // Instructions retained for reflection, indexed by op code, see get_op_code_name
+        uint64_t type_conversions = 0;          // Distinct combinations of SPIR-V type and matrix stride converted
+        uint64_t interned_types = 0;            // Types in the resulting type graphs, after identical types are merged
+        uint64_t tree_types = 0;                // Type nodes built for module_info trees
+        uint64_t bytes_allocated = 0;           // Capacity of the lookup tables built while loading, and of the arrays of each flat_module_info
+
+        uint64_t id_lookups = 0;                // Instructions found by ID (SPVI_COUNT_LOOKUPS only)
+        uint64_t name_lookups = 0;              // Debug names of IDs and struct members looked up (SPVI_COUNT_LOOKUPS only)
+        uint64_t decoration_lookups = 0;        // Decorations of IDs and struct members looked up (SPVI_COUNT_LOOKUPS only)
+        uint64_t type_cache_hits = 0;           // Type conversions answered by a type which was already converted (SPVI_COUNT_LOOKUPS only)
+    };
+
+    // Returns the name of an op code which reflection retains, such as "OpTypeStruct", or nullptr for any other op code
+    const char * get_op_code_name(uint32_t op_code);
+
+    struct flat_module_info;
+
     // The metadata for a complete SPIR-V module
     struct module_info
     {
         std::vector<descriptor_set_info> descriptor_sets;
+        std::vector<variable_info> push_constants;  // Push constant blocks, of which there is at most one per entry point
         std::vector<entry_point_info> entry_points;
+        std::vector<specialization_constant_info> specialization_constants; // Sorted by constant_id
+        std::vector<specialization_op> specialization_program;              // Computes the lengths of arrays sized by specialization constants
+
+        module_info() = default;
+        module_info(const uint32_t * words, size_t word_count, reflection_profile * profile = nullptr);
+        module_info(const std::vector<uint32_t> & words, reflection_profile * profile = nullptr) : module_info{words.data(), words.size(), profile} {}
+        explicit module_info(const flat_module_info & flat, reflection_profile * profile = nullptr);
+    };
+
+    // Equivalent of variable_info, referring to its type and name within a type_graph
+    struct flat_variable_info
+    {
+        uint32_t index;
+        type_graph::type_index type;
+        type_graph::string_index name;
+        VkDescriptorType descriptor_type;
+    };
+
+    // Equivalent of descriptor_set_info, referring to a range of flat_module_info::variables
+    struct flat_descriptor_set_info
+    {
+        uint32_t set;
+        uint32_t first_descriptor, descriptor_count;
+    };
 
-        module_info(const uint32_t * words, size_t word_count);
-        module_info(const std::vector<uint32_t> & words) : module_info{words.data(), words.size()} {}
+    // Equivalent of entry_point_info, referring to ranges of flat_module_info::variables
+    struct flat_entry_point_info
+    {
+        VkShaderStageFlagBits stage;
+        uint32_t first_input, input_count;
+        uint32_t first_output, output_count;
+        type_graph::string_index name;
     };
-}
\ No newline at end of file
+
+    // Equivalent of specialization_constant_info, referring to its name within a type_graph
+    struct flat_specialization_constant_info
+    {
+        uint32_t constant_id;
+        type_graph::string_index name;
+        type::number_kind elem_kind;
+        size_t elem_width;
+        bool is_bool;
+        uint64_t default_value;
+    };
+
+    // The arrays of a flat_module_info which describe the interface of a module, referring to types and names within a type_graph which is stored separately
+    struct flat_module_interface
+    {
+        std::vector<flat_variable_info> variables;
+        std::vector<flat_descriptor_set_info> descriptor_sets;
+        std::vector<flat_variable_info> push_constants;
+        std::vector<flat_entry_point_info> entry_points;
+        std::vector<flat_specialization_constant_info> specialization_constants;
+        std::vector<specialization_op> specialization_program;
+    };
+
+    // The metadata for a complete SPIR-V module, stored in a handful of contiguous arrays. Each distinct type is converted only once,
+    // and is shared by every variable and member which refers to it. module_info provides the equivalent tree-based view.
+    struct flat_module_info : flat_module_interface
+    {
+        type_graph types;
+
+        flat_module_info() = default;
+        flat_module_info(const uint32_t * words, size_t word_count, reflection_profile * profile = nullptr);
+        flat_module_info(const std::vector<uint32_t> & words, reflection_profile * profile = nullptr) : flat_module_info{words.data(), words.size(), profile} {}
+
+        // Flattens a tree-based module_info, such as one which was specialized or deserialized. Types which are shared or identical are stored only once.
+        explicit flat_module_info(const module_info & info);
+    };
+
+    // Re-evaluates the lengths of arrays sized by specialization constants, along with the sizes of the structures which contain them, for a given set
+    // of values. Constants which are not given a value keep their default. The SPIR-V binary is not needed, so each variant of a module_info costs only
+    // a walk over the affected types, and types which do not depend on any specialization constant remain shared with the original module. The
+    // flat_module_info overload copies the whole graph and recomputes the size and hash of every type, so that indices into it remain valid.
+    // Throws std::logic_error if the values lead to a division by zero, or if VkSpecializationInfo refers to data outside of its bounds.
+    module_info specialize(const module_info & info, const specialization_value * values, size_t value_count);
+    inline module_info specialize(const module_info & info, const std::vector<specialization_value> & values) { return specialize(info, values.data(), values.size()); }
+    module_info specialize(const module_info & info, const VkSpecializationInfo & specialization_info);
+    flat_module_info specialize(const flat_module_info & info, const specialization_value * values, size_t value_count);
+    inline flat_module_info specialize(const flat_module_info & info, const std::vector<specialization_value> & values) { return specialize(info, values.data(), values.size()); }
+
+    // Memory used by a module_family, compared with reflecting each of its modules into a flat_module_info of its own
+    struct family_memory_usage
+    {
+        size_t shared_bytes;    // Capacity of the shared type_graph
+        size_t module_bytes;    // Capacity of the interfaces of the modules
+        size_t unshared_bytes;  // Size of the type graphs which the modules would have if each had its own, holding only the types and names it refers to
+
+        size_t get_deduplicated_bytes() const { return unshared_bytes > shared_bytes ? unshared_bytes - shared_bytes : 0; }
+    };
+
+    // A set of related modules, such as the permutations of a shader which differ by a few preprocessor definitions, reflected into a single type_graph
+    // so that the types and names they have in common are stored only once. Each module keeps only its interface, whose type and string indices refer
+    // to the shared graph, so that adding a permutation costs little more than its variables and entry points.
+    class module_family
+    {
+        struct shared_types;
+        std::unique_ptr<shared_types> shared;   // The shared graph, along with the tables which intern further types into it
+        std::vector<flat_module_interface> modules;
+        size_t unshared_bytes = 0;
+    public:
+        module_family();
+        module_family(module_family && r) noexcept;
+        module_family & operator = (module_family && r) noexcept;
+        ~module_family();
+
+        // Reflects a module into the family, returning its index. Throws as the constructor of flat_module_info would, in which case no module is added,
+        // although types which were interned before the error was found remain in the shared graph.
+        size_t add_module(const uint32_t * words, size_t word_count, reflection_profile * profile = nullptr);
+        size_t add_module(const std::vector<uint32_t> & words, reflection_profile * profile = nullptr) { return add_module(words.data(), words.size(), profile); }
+
+        size_t get_module_count() const { return modules.size(); }
+        const type_graph & get_types() const;
+        const flat_module_interface & get_module(size_t index) const { return modules[index]; }
+
+        // Copies a module out of the family, along with only the types and names which it refers to, or converts it into the tree-based module_info
+        flat_module_info get_flat_module_info(size_t index) const;
+        module_info get_module_info(size_t index) const { return module_info{get_flat_module_info(index)}; }
+
+        family_memory_usage get_memory_usage() const;
+    };
+
+    // A SPIR-V binary minimized by strip_module, along with the interface reflected from the original binary
+    struct stripped_module
+    {
+        module_info info;               // Reflected before stripping, so that it still holds the debug names
+        std::vector<uint32_t> words;    // The stripped binary
+    };
+
+    // Removes what a driver does not need from a SPIR-V binary: debug names, strings, source and line information, types and constants which nothing
+    // refers to, and the decorations of anything which was removed. IDs are not renumbered, so the bound in the header is unchanged. The stripped binary
+    // is reflected again and compared with the original interface, ignoring names, and std::logic_error is thrown if they differ. Throws std::runtime_error
+    // if the binary is malformed, and otherwise whatever the constructor of module_info would throw for it.
+    stripped_module strip_module(const uint32_t * words, size_t word_count);
+    inline stripped_module strip_module(const std::vector<uint32_t> & words) { return strip_module(words.data(), words.size()); }
+
+    // The positions of the instructions within a SPIR-V binary which reflection decodes: names, entry points, types, constants, global variables and decorations
+    struct instruction_index
+    {
+        std::vector<uint32_t> offsets;  // Offset in words from the start of the binary of each such instruction, in order
+        size_t declarations_end;        // Offset of the first function definition, or the size of the binary if it has none
+    };
+
+    // Finds the instructions which reflection decodes in a single pass over the instruction lengths, stopping at the first function definition.
+    // Only the lengths are checked, throwing std::runtime_error if the binary is not SPIR-V or an instruction runs past the end of the binary.
+    instruction_index index_instructions(const uint32_t * words, size_t word_count);
+    inline instruction_index index_instructions(const std::vector<uint32_t> & words) { return index_instructions(words.data(), words.size()); }
+
+    // Incremental reflection of a SPIR-V binary which arrives in chunks, such as from a stream or a decompressor. Chunks may begin and end
+    // anywhere, including partway through an instruction. Only the header and the declarations which are relevant to reflection are retained,
+    // and input is no longer needed once the first function definition begins, as all declarations must precede it.
+    class module_parser
+    {
+        std::vector<uint32_t> words;    // The header and the retained instructions received so far
+        size_t retained_words = 0;      // Words still to come of an instruction which is being retained
+        size_t skipped_words = 0;       // Words still to come of an instruction which is being discarded
+        bool complete = false;
+    public:
+        // Consumes the next chunk of the binary. Throws std::runtime_error if the binary is malformed. Input is ignored once is_complete() returns true.
+        void feed(const uint32_t * chunk, size_t word_count);
+        void feed(const std::vector<uint32_t> & chunk) { feed(chunk.data(), chunk.size()); }
+
+        // True once the declarations section has been fully received, at which point the module can be finished without waiting for the rest of the binary
+        bool is_complete() const { return complete; }
+
+        // Reflects the declarations received so far. Throws std::runtime_error if the input ended partway through the header or an instruction.
+        flat_module_info finish_flat() const;
+        module_info finish() const { return module_info{finish_flat()}; }
+    };
+
+    // The kinds of error which reflection can report
+    enum class reflection_errc
+    {
+        success,
+        not_spirv,              // The binary is too short to hold a header, or does not begin with the SPIR-V magic number
+        malformed_instruction,  // An instruction's word count is zero, runs past the end of the binary, or does not match the operands of its op code
+        invalid_id,             // An ID is not less than the bound from the header, or does not refer to an instruction which defines it
+        invalid_module,         // The binary is well formed but is not a valid shader module, such as a descriptor without a set or binding
+        unsupported,            // The module uses a construct which reflection does not handle, such as an unknown image format or execution model
+        out_of_memory,
+    };
+
+    // A failure reported by try_reflect and try_reflect_flat
+    struct reflection_error
+    {
+        static constexpr size_t unknown_offset = SIZE_MAX;
+
+        reflection_errc code;
+        size_t word_offset;     // Offset in words from the start of the binary of the instruction at fault, or unknown_offset
+        const char * message;   // A static description of the failure, the same text which the throwing API would report
+    };
+
+    // Holds either a reflected value or the error which prevented it from being reflected, in the manner of C++23's std::expected
+    template<class T> class expected
+    {
+        std::variant<T, reflection_error> contents;
+    public:
+        expected(T && value) : contents{std::in_place_index<0>, std::move(value)} {}
+        expected(const reflection_error & error) : contents{std::in_place_index<1>, error} {}
+
+        bool has_value() const { return contents.index() == 0; }
+        explicit operator bool () const { return has_value(); }
+        T & value() { return std::get<0>(contents); }
+        const T & value() const { return std::get<0>(contents); }
+        const reflection_error & error() const { return std::get<1>(contents); }
+        T & operator * () { return value(); }
+        const T & operator * () const { return value(); }
+        T * operator -> () { return &value(); }
+        const T * operator -> () const { return &value(); }
+    };
+
+    // Reflects a module as the constructors of flat_module_info and module_info do, but returns failures as error codes instead of throwing them.
+    // No error is thrown internally, whether it is structural, such as a bad word count or an out of bounds ID, or found while converting types and
+    // variables, such as an unsupported image Dim, so that probing large numbers of malformed binaries is not dominated by the cost of unwinding.
+    // Missing debug names, as in stripped binaries, are not errors for either API, and are reflected as empty strings.
+    expected<flat_module_info> try_reflect_flat(const uint32_t * words, size_t word_count) noexcept;
+    expected<module_info> try_reflect(const uint32_t * words, size_t word_count) noexcept;
+    inline expected<flat_module_info> try_reflect_flat(const std::vector<uint32_t> & words) noexcept { return try_reflect_flat(words.data(), words.size()); }
+    inline expected<module_info> try_reflect(const std::vector<uint32_t> & words) noexcept { return try_reflect(words.data(), words.size()); }
+
+    // A SPIR-V binary whose storage is owned by the caller
+    struct binary_view
+    {
+        const uint32_t * words;
+        size_t word_count;
+    };
+
+    // The outcome of reflecting a single module as part of a batch
+    struct reflection_result
+    {
+        std::optional<module_info> info;    // The reflected interface, if reflection succeeded
+        std::string error;                  // A description of the failure, if reflection did not succeed
+        reflection_errc error_code = reflection_errc::success; // The kind of failure, if reflection did not succeed
+    };
+
+    // Reflects a batch of modules concurrently, returning one result per module, in input order. Failures are captured in the 
+    // corresponding result instead of being thrown. If thread_count is zero, one thread is used per hardware thread.
+    std::vector<reflection_result> reflect_many(const binary_view * binaries, size_t binary_count, size_t thread_count = 0);
+    inline std::vector<reflection_result> reflect_many(const std::vector<binary_view> & binaries, size_t thread_count = 0) { return reflect_many(binaries.data(), binaries.size(), thread_count); }
+}
+
+namespace std
+{
+    template<> struct hash<spvi::type> { size_t operator() (const spvi::type & t) const { return static_cast<size_t>(spvi::hash_type(t)); } };
+}
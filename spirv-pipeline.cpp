@@ -0,0 +1,371 @@
+#include "spirv-pipeline.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace
+{
+    using spvi::hash_combine;
+
+    bool equal_bindings(const VkDescriptorSetLayoutBinding & a, const VkDescriptorSetLayoutBinding & b)
+    {
+        return std::tie(a.binding, a.descriptorType, a.descriptorCount, a.stageFlags, a.pImmutableSamplers) == std::tie(b.binding, b.descriptorType, b.descriptorCount, b.stageFlags, b.pImmutableSamplers);
+    }
+
+    // Determines the number of descriptors occupied by a uniform, which is greater than one for arrays of descriptors, and zero for runtime arrays
+    uint32_t get_descriptor_count(const spvi::type & type)
+    {
+        if(auto * a = std::get_if<spvi::type::array>(&type.contents)) return static_cast<uint32_t>(a->elem_count) * get_descriptor_count(a->elem_type);
+        return 1;
+    }
+
+    // The range of a push constant block runs from its first member to the end of the block
+    VkPushConstantRange get_push_constant_range(const spvi::type & type, VkShaderStageFlags stages)
+    {
+        auto * s = std::get_if<spvi::type::structure>(&type.contents);
+        if(!s) throw std::logic_error("push constant block is not a structure");
+        size_t offset = s->size;
+        for(auto & m : s->members) offset = std::min(offset, m.offset.value_or(0));
+        return {stages, static_cast<uint32_t>(offset), static_cast<uint32_t>(s->size - offset)};
+    }
+
+    // Appends the slots occupied by a value of the given type, starting at the given location, and returns the location following it
+    uint32_t add_interface_slots(std::vector<spvi::interface_slot> & slots, const spvi::type & type, uint32_t location)
+    {
+        if(auto * x = std::get_if<spvi::type::numeric>(&type.contents))
+        {
+            // Each column of a matrix occupies its own locations, and 64-bit vectors of more than two components occupy two locations
+            const uint32_t locations_per_column = x->elem_width == 64 && x->row_count > 2 ? 2 : 1;
+            for(size_t i=0; i<x->column_count; ++i, location += locations_per_column)
+            {
+                slots.push_back({location, x->elem_kind, static_cast<uint32_t>(x->elem_width), static_cast<uint32_t>(x->row_count)});
+            }
+            return location;
+        }
+        if(auto * a = std::get_if<spvi::type::array>(&type.contents))
+        {
+            if(a->elem_count == 0) throw std::logic_error("runtime array in stage interface");
+            for(size_t i=0; i<a->elem_count; ++i) location = add_interface_slots(slots, a->elem_type, location);
+            return location;
+        }
+        if(auto * s = std::get_if<spvi::type::structure>(&type.contents))
+        {
+            for(auto & m : s->members) location = add_interface_slots(slots, m.member_type, location);
+            return location;
+        }
+        throw std::logic_error("opaque type in stage interface");
+    }
+
+    bool is_per_vertex_input(VkShaderStageFlagBits stage) { return stage == VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT || stage == VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT || stage == VK_SHADER_STAGE_GEOMETRY_BIT; }
+    bool is_per_vertex_output(VkShaderStageFlagBits stage) { return stage == VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; }
+
+    // The vertex formats of each kind of component, indexed by component count minus one
+    struct vertex_format_row
+    {
+        uint32_t component_size;
+        VkFormat formats[4];
+    };
+    enum vertex_format_kind { unorm8, snorm8, uint8, sint8, unorm16, snorm16, uint16, sint16, sfloat16, uint32, sint32, sfloat32, uint64, sint64, sfloat64 };
+    const vertex_format_row vertex_formats[] {
+        {1, {VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM}},
+        {1, {VK_FORMAT_R8_SNORM, VK_FORMAT_R8G8_SNORM, VK_FORMAT_R8G8B8_SNORM, VK_FORMAT_R8G8B8A8_SNORM}},
+        {1, {VK_FORMAT_R8_UINT, VK_FORMAT_R8G8_UINT, VK_FORMAT_R8G8B8_UINT, VK_FORMAT_R8G8B8A8_UINT}},
+        {1, {VK_FORMAT_R8_SINT, VK_FORMAT_R8G8_SINT, VK_FORMAT_R8G8B8_SINT, VK_FORMAT_R8G8B8A8_SINT}},
+        {2, {VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16A16_UNORM}},
+        {2, {VK_FORMAT_R16_SNORM, VK_FORMAT_R16G16_SNORM, VK_FORMAT_R16G16B16_SNORM, VK_FORMAT_R16G16B16A16_SNORM}},
+        {2, {VK_FORMAT_R16_UINT, VK_FORMAT_R16G16_UINT, VK_FORMAT_R16G16B16_UINT, VK_FORMAT_R16G16B16A16_UINT}},
+        {2, {VK_FORMAT_R16_SINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16B16_SINT, VK_FORMAT_R16G16B16A16_SINT}},
+        {2, {VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT}},
+        {4, {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT}},
+        {4, {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT}},
+        {4, {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT}},
+        {8, {VK_FORMAT_R64_UINT, VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64B64_UINT, VK_FORMAT_R64G64B64A64_UINT}},
+        {8, {VK_FORMAT_R64_SINT, VK_FORMAT_R64G64_SINT, VK_FORMAT_R64G64B64_SINT, VK_FORMAT_R64G64B64A64_SINT}},
+        {8, {VK_FORMAT_R64_SFLOAT, VK_FORMAT_R64G64_SFLOAT, VK_FORMAT_R64G64B64_SFLOAT, VK_FORMAT_R64G64B64A64_SFLOAT}},
+    };
+
+    // Selects the kind of vertex format which can supply a given kind of input from a given storage
+    vertex_format_kind get_vertex_format_kind(const spvi::type::numeric & input, spvi::vertex_storage storage)
+    {
+        // Vulkan requires 64-bit inputs to be read from 64-bit formats
+        if(input.elem_width == 64 && storage != spvi::vertex_storage::native) throw std::logic_error("64-bit vertex input requires native storage");
+        const bool is_float = input.elem_kind == spvi::type::float_, is_signed = input.elem_kind == spvi::type::int_;
+        switch(storage)
+        {
+        case spvi::vertex_storage::native:
+            switch(input.elem_width)
+            {
+            case 8: if(!is_float) return is_signed ? sint8 : uint8; break;
+            case 16: return is_float ? sfloat16 : is_signed ? sint16 : uint16;
+            case 32: return is_float ? sfloat32 : is_signed ? sint32 : uint32;
+            case 64: return is_float ? sfloat64 : is_signed ? sint64 : uint64;
+            }
+            break;
+        case spvi::vertex_storage::float16: if(is_float) return sfloat16; break;
+        case spvi::vertex_storage::unorm8: if(is_float) return unorm8; break;
+        case spvi::vertex_storage::snorm8: if(is_float) return snorm8; break;
+        case spvi::vertex_storage::unorm16: if(is_float) return unorm16; break;
+        case spvi::vertex_storage::snorm16: if(is_float) return snorm16; break;
+        case spvi::vertex_storage::int8: if(!is_float && input.elem_width <= 32) return is_signed ? sint8 : uint8; break;
+        case spvi::vertex_storage::int16: if(!is_float && input.elem_width <= 32) return is_signed ? sint16 : uint16; break;
+        }
+        throw std::logic_error("vertex storage cannot supply input");
+    }
+
+    // Assigns each distinct signature a small index, so that comparisons between identical pairs of signatures can be shared
+    std::vector<uint32_t> get_unique_indices(const spvi::interface_signature * signatures, size_t count, std::vector<const spvi::interface_signature *> & unique)
+    {
+        std::unordered_map<spvi::interface_signature, uint32_t> indices;
+        std::vector<uint32_t> result(count);
+        for(size_t i=0; i<count; ++i)
+        {
+            auto it = indices.emplace(signatures[i], static_cast<uint32_t>(unique.size())).first;
+            if(it->second == unique.size()) unique.push_back(&signatures[i]);
+            result[i] = it->second;
+        }
+        return result;
+    }
+}
+
+bool spvi::operator == (const descriptor_set_layout_desc & a, const descriptor_set_layout_desc & b) { return std::equal(a.bindings.begin(), a.bindings.end(), b.bindings.begin(), b.bindings.end(), equal_bindings); }
+bool spvi::operator == (const pipeline_layout_desc & a, const pipeline_layout_desc & b)
+{
+    auto equal_ranges = [](const VkPushConstantRange & a, const VkPushConstantRange & b) { return std::tie(a.stageFlags, a.offset, a.size) == std::tie(b.stageFlags, b.offset, b.size); };
+    return a.set_layouts == b.set_layouts && std::equal(a.push_constant_ranges.begin(), a.push_constant_ranges.end(), b.push_constant_ranges.begin(), b.push_constant_ranges.end(), equal_ranges);
+}
+
+uint64_t spvi::hash_layout(const descriptor_set_layout_desc & desc)
+{
+    uint64_t h = desc.bindings.size();
+    for(auto & b : desc.bindings) for(uint64_t v : {uint64_t(b.binding), uint64_t(b.descriptorType), uint64_t(b.descriptorCount), uint64_t(b.stageFlags), uint64_t(reinterpret_cast<uintptr_t>(b.pImmutableSamplers))}) h = hash_combine(h, v);
+    return h;
+}
+
+uint64_t spvi::hash_layout(const pipeline_layout_desc & desc)
+{
+    uint64_t h = desc.set_layouts.size();
+    for(auto & s : desc.set_layouts) h = hash_combine(h, hash_layout(s));
+    for(auto & r : desc.push_constant_ranges) for(uint64_t v : {uint64_t(r.stageFlags), uint64_t(r.offset), uint64_t(r.size)}) h = hash_combine(h, v);
+    return h;
+}
+
+spvi::pipeline_layout_desc spvi::merge_pipeline_layout(const module_info * const * modules, size_t module_count)
+{
+    std::map<std::pair<uint32_t, uint32_t>, VkDescriptorSetLayoutBinding> bindings;
+    std::map<VkShaderStageFlags, std::pair<uint32_t, uint32_t>> push_constant_extents; // The first and one past the last byte used by each stage
+    for(size_t i=0; i<module_count; ++i)
+    {
+        VkShaderStageFlags stages = 0;
+        for(auto & e : modules[i]->entry_points) stages |= e.stage;
+
+        for(auto & set : modules[i]->descriptor_sets)
+        {
+            for(auto & d : set.descriptors)
+            {
+                const uint32_t count = get_descriptor_count(d.type);
+                auto it = bindings.find({set.set, d.index});
+                if(it == bindings.end()) bindings.insert({{set.set, d.index}, {d.index, d.descriptor_type, count, stages, nullptr}});
+                else if(it->second.descriptorType != d.descriptor_type || it->second.descriptorCount != count) throw std::logic_error("conflicting declarations of set " + std::to_string(set.set) + " binding " + std::to_string(d.index));
+                else it->second.stageFlags |= stages;
+            }
+        }
+
+        // A module does not say which of its entry points use which push constant block, so each of its stages covers all of them
+        for(auto & p : modules[i]->push_constants)
+        {
+            const auto range = get_push_constant_range(p.type, stages);
+            for(auto & e : modules[i]->entry_points)
+            {
+                auto it = push_constant_extents.emplace(e.stage, std::make_pair(range.offset, range.offset + range.size)).first;
+                it->second = {std::min(it->second.first, range.offset), std::max(it->second.second, range.offset + range.size)};
+            }
+        }
+    }
+
+    // Each stage may appear in only one range, so stages share a range only when their extents are identical
+    std::map<std::pair<uint32_t, uint32_t>, VkShaderStageFlags> push_constant_ranges;
+    for(auto & e : push_constant_extents) push_constant_ranges[e.second] |= e.first;
+
+    // The map is ordered by set and then binding, so each set's bindings arrive already sorted
+    pipeline_layout_desc desc;
+    for(auto & b : bindings)
+    {
+        if(desc.set_layouts.size() <= b.first.first) desc.set_layouts.resize(b.first.first + 1);
+        desc.set_layouts[b.first.first].bindings.push_back(b.second);
+    }
+    for(auto & r : push_constant_ranges) desc.push_constant_ranges.push_back({r.second, r.first.first, r.first.second - r.first.first});
+    return desc;
+}
+
+spvi::pipeline_layout_cache::pipeline_layout_cache(set_layout_factory create_set_layout, pipeline_layout_factory create_pipeline_layout) :
+    create_set_layout{std::move(create_set_layout)}, create_pipeline_layout{std::move(create_pipeline_layout)} {}
+
+VkDescriptorSetLayout spvi::pipeline_layout_cache::get_set_layout_locked(const descriptor_set_layout_desc & desc)
+{
+    auto it = set_layouts.find(desc);
+    if(it != set_layouts.end()) return it->second;
+    const auto layout = create_set_layout(desc.get_create_info());
+    set_layouts.emplace(desc, layout);
+    return layout;
+}
+
+VkDescriptorSetLayout spvi::pipeline_layout_cache::get_set_layout(const descriptor_set_layout_desc & desc)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return get_set_layout_locked(desc);
+}
+
+VkPipelineLayout spvi::pipeline_layout_cache::get_pipeline_layout(const pipeline_layout_desc & desc)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = pipeline_layouts.find(desc);
+    if(it != pipeline_layouts.end()) return it->second;
+
+    std::vector<VkDescriptorSetLayout> handles;
+    for(auto & s : desc.set_layouts) handles.push_back(get_set_layout_locked(s));
+    const VkPipelineLayoutCreateInfo create_info {VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, nullptr, 0, static_cast<uint32_t>(handles.size()), handles.data(),
+        static_cast<uint32_t>(desc.push_constant_ranges.size()), desc.push_constant_ranges.data()};
+    const auto layout = create_pipeline_layout(create_info);
+    pipeline_layouts.emplace(desc, layout);
+    return layout;
+}
+
+std::vector<VkDescriptorSetLayout> spvi::pipeline_layout_cache::get_set_layouts() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<VkDescriptorSetLayout> r;
+    for(auto & p : set_layouts) r.push_back(p.second);
+    return r;
+}
+
+std::vector<VkPipelineLayout> spvi::pipeline_layout_cache::get_pipeline_layouts() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<VkPipelineLayout> r;
+    for(auto & p : pipeline_layouts) r.push_back(p.second);
+    return r;
+}
+
+bool spvi::operator == (const interface_slot & a, const interface_slot & b) { return std::tie(a.location, a.elem_kind, a.elem_width, a.component_count) == std::tie(b.location, b.elem_kind, b.elem_width, b.component_count); }
+bool spvi::operator == (const interface_signature & a, const interface_signature & b) { return a.hash == b.hash && a.slots == b.slots; }
+
+spvi::interface_signature spvi::get_interface_signature(const std::vector<variable_info> & variables, bool per_vertex)
+{
+    interface_signature signature;
+    for(auto & v : variables)
+    {
+        // Variables which are not arrays can only be per-patch, and are kept whole
+        auto * a = std::get_if<type::array>(&v.type.contents);
+        add_interface_slots(signature.slots, per_vertex && a ? static_cast<const type &>(a->elem_type) : v.type, v.index);
+    }
+
+    // Variables are sorted by their first location, but a variable which spans several locations may overlap those that follow it
+    std::stable_sort(signature.slots.begin(), signature.slots.end(), [](const interface_slot & a, const interface_slot & b) { return a.location < b.location; });
+    for(auto & s : signature.slots) for(uint64_t v : {uint64_t(s.location), uint64_t(s.elem_kind), uint64_t(s.elem_width), uint64_t(s.component_count)}) signature.hash = hash_combine(signature.hash, v);
+    return signature;
+}
+
+spvi::interface_signature spvi::get_input_signature(const entry_point_info & entry_point) { return get_interface_signature(entry_point.inputs, is_per_vertex_input(entry_point.stage)); }
+spvi::interface_signature spvi::get_output_signature(const entry_point_info & entry_point) { return get_interface_signature(entry_point.outputs, is_per_vertex_output(entry_point.stage)); }
+
+bool spvi::is_interface_compatible(const interface_signature & outputs, const interface_signature & inputs)
+{
+    if(outputs == inputs) return true;
+
+    // Both lists are sorted by location, so each input can be matched by advancing through the outputs in step
+    auto out = outputs.slots.begin();
+    for(auto & in : inputs.slots)
+    {
+        while(out != outputs.slots.end() && out->location < in.location) ++out;
+        bool matched = false;
+        for(auto o = out; o != outputs.slots.end() && o->location == in.location && !matched; ++o)
+        {
+            matched = o->elem_kind == in.elem_kind && o->elem_width == in.elem_width && o->component_count >= in.component_count;
+        }
+        if(!matched) return false;
+    }
+    return true;
+}
+
+std::vector<uint8_t> spvi::check_interface_compatibility(const interface_signature * outputs, size_t output_count, const interface_signature * inputs, size_t input_count)
+{
+    std::vector<const interface_signature *> unique_outputs, unique_inputs;
+    const auto output_indices = get_unique_indices(outputs, output_count, unique_outputs), input_indices = get_unique_indices(inputs, input_count, unique_inputs);
+
+    std::vector<uint8_t> unique_results(unique_outputs.size() * unique_inputs.size());
+    for(size_t i=0; i<unique_outputs.size(); ++i) for(size_t j=0; j<unique_inputs.size(); ++j) unique_results[i * unique_inputs.size() + j] = is_interface_compatible(*unique_outputs[i], *unique_inputs[j]);
+
+    std::vector<uint8_t> results(output_count * input_count);
+    for(size_t i=0; i<output_count; ++i)
+    {
+        const uint8_t * row = unique_results.data() + output_indices[i] * unique_inputs.size();
+        uint8_t * out = results.data() + i * input_count;
+        for(size_t j=0; j<input_count; ++j) out[j] = row[input_indices[j]];
+    }
+    return results;
+}
+
+VkFormat spvi::get_vertex_format(const type::numeric & input, vertex_storage storage)
+{
+    if(input.row_count < 1 || input.row_count > 4) throw std::logic_error("vertex input has too many components");
+    const auto & row = vertex_formats[get_vertex_format_kind(input, storage)];
+    return row.formats[row.component_size < 4 && input.row_count == 3 ? 3 : input.row_count - 1];
+}
+
+uint32_t spvi::get_vertex_format_size(VkFormat format)
+{
+    for(auto & row : vertex_formats) for(uint32_t i=0; i<4; ++i) if(row.formats[i] == format) return row.component_size * (i+1);
+    throw std::logic_error("not a vertex format");
+}
+
+spvi::vertex_input_layout spvi::get_vertex_input_layout(const entry_point_info & vertex_stage, const vertex_attribute_storage * storages, size_t storage_count, bool interleaved)
+{
+    if(vertex_stage.stage != VK_SHADER_STAGE_VERTEX_BIT) throw std::logic_error("entry point is not a vertex shader");
+    auto get_storage = [&](uint32_t location)
+    {
+        for(size_t i=0; i<storage_count; ++i) if(storages[i].location == location) return storages[i].storage;
+        return vertex_storage::native;
+    };
+
+    // Each location of an input, including each column of a matrix and each element of an array, is supplied by its own attribute
+    vertex_input_layout layout;
+    for(auto & input : vertex_stage.inputs)
+    {
+        std::vector<interface_slot> slots;
+        add_interface_slots(slots, input.type, input.index);
+        for(auto & s : slots)
+        {
+            const type::numeric column {s.elem_kind, s.elem_width, s.component_count, 1, s.elem_width/8, 0};
+            layout.attributes.push_back({s.location, 0, get_vertex_format(column, get_storage(s.location)), 0});
+        }
+    }
+    std::sort(layout.attributes.begin(), layout.attributes.end(), [](const VkVertexInputAttributeDescription & a, const VkVertexInputAttributeDescription & b) { return a.location < b.location; });
+
+    if(!interleaved)
+    {
+        for(auto & a : layout.attributes)
+        {
+            a.binding = static_cast<uint32_t>(layout.bindings.size());
+            layout.bindings.push_back({a.binding, get_vertex_format_size(a.format), VK_VERTEX_INPUT_RATE_VERTEX});
+        }
+        return layout;
+    }
+
+    // Every size is a multiple of its component size, and component sizes are powers of two, so placing the attributes with the largest components
+    // first keeps every attribute aligned without padding. Only the end of the vertex is padded, so that the next vertex is aligned as well.
+    auto get_component_size = [](VkFormat format) { for(auto & row : vertex_formats) for(auto f : row.formats) if(f == format) return row.component_size; return 1u; };
+    std::vector<VkVertexInputAttributeDescription *> order;
+    for(auto & a : layout.attributes) order.push_back(&a);
+    std::stable_sort(order.begin(), order.end(), [&](const VkVertexInputAttributeDescription * a, const VkVertexInputAttributeDescription * b) { return get_component_size(a->format) > get_component_size(b->format); });
+    uint32_t stride = 0, alignment = 1;
+    for(auto * a : order)
+    {
+        a->offset = stride;
+        stride += get_vertex_format_size(a->format);
+        alignment = std::max(alignment, get_component_size(a->format));
+    }
+    if(!layout.attributes.empty()) layout.bindings.push_back({0, (stride + alignment - 1) / alignment * alignment, VK_VERTEX_INPUT_RATE_VERTEX});
+    return layout;
+}
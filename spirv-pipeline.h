@@ -0,0 +1,170 @@
+#pragma once
+#include "spirv-interface.h"
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+
+namespace spvi
+{
+    // The canonical form of a descriptor set layout, with bindings sorted by binding index and no immutable samplers,
+    // so that layouts which would behave identically always compare and hash equal
+    struct descriptor_set_layout_desc
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+        // The returned structure refers to this object's bindings, and is only valid for as long as they are
+        VkDescriptorSetLayoutCreateInfo get_create_info() const { return {VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr, 0, static_cast<uint32_t>(bindings.size()), bindings.data()}; }
+    };
+
+    // The canonical form of a pipeline layout, with one set layout for every set index from zero up to the highest set in use.
+    // Set indices which are skipped by the shaders are given empty layouts, as Vulkan requires the set layouts to be contiguous.
+    // Push constant ranges are sorted by offset and size, and stages which use an identical range share a single entry.
+    struct pipeline_layout_desc
+    {
+        std::vector<descriptor_set_layout_desc> set_layouts;
+        std::vector<VkPushConstantRange> push_constant_ranges;
+    };
+
+    bool operator == (const descriptor_set_layout_desc & a, const descriptor_set_layout_desc & b);
+    bool operator == (const pipeline_layout_desc & a, const pipeline_layout_desc & b);
+    inline bool operator != (const descriptor_set_layout_desc & a, const descriptor_set_layout_desc & b) { return !(a == b); }
+    inline bool operator != (const pipeline_layout_desc & a, const pipeline_layout_desc & b) { return !(a == b); }
+    uint64_t hash_layout(const descriptor_set_layout_desc & desc);
+    uint64_t hash_layout(const pipeline_layout_desc & desc);
+
+    // Merges the descriptor sets and push constants of the shader modules which make up a pipeline, giving each binding and range the stage flags
+    // of every entry point in every module which declares it. Throws std::logic_error if two modules declare the same binding differently.
+    // Each stage's push constant range spans every push constant block in its modules, and stages share a range only if they span the same bytes.
+    // Runtime arrays of descriptors are given a descriptor count of zero, which the caller must replace with an upper bound.
+    pipeline_layout_desc merge_pipeline_layout(const module_info * const * modules, size_t module_count);
+    inline pipeline_layout_desc merge_pipeline_layout(std::initializer_list<const module_info *> modules) { return merge_pipeline_layout(modules.begin(), modules.size()); }
+}
+
+namespace std
+{
+    template<> struct hash<spvi::descriptor_set_layout_desc> { size_t operator() (const spvi::descriptor_set_layout_desc & d) const { return static_cast<size_t>(spvi::hash_layout(d)); } };
+    template<> struct hash<spvi::pipeline_layout_desc> { size_t operator() (const spvi::pipeline_layout_desc & d) const { return static_cast<size_t>(spvi::hash_layout(d)); } };
+}
+
+namespace spvi
+{
+    // Creates each distinct descriptor set layout and pipeline layout only once, returning the existing object for any layout seen before.
+    // The Vulkan objects are created by caller-supplied functions, typically wrapping vkCreateDescriptorSetLayout and vkCreatePipelineLayout,
+    // and remain owned by the caller, who should destroy the objects returned by get_set_layouts() and get_pipeline_layouts() when done.
+    // All member functions may be called concurrently.
+    class pipeline_layout_cache
+    {
+    public:
+        typedef std::function<VkDescriptorSetLayout(const VkDescriptorSetLayoutCreateInfo & create_info)> set_layout_factory;
+        typedef std::function<VkPipelineLayout(const VkPipelineLayoutCreateInfo & create_info)> pipeline_layout_factory;
+    private:
+        set_layout_factory create_set_layout;
+        pipeline_layout_factory create_pipeline_layout;
+        mutable std::mutex mutex;
+        std::unordered_map<descriptor_set_layout_desc, VkDescriptorSetLayout> set_layouts;
+        std::unordered_map<pipeline_layout_desc, VkPipelineLayout> pipeline_layouts;
+
+        VkDescriptorSetLayout get_set_layout_locked(const descriptor_set_layout_desc & desc);
+    public:
+        pipeline_layout_cache(set_layout_factory create_set_layout, pipeline_layout_factory create_pipeline_layout);
+
+        VkDescriptorSetLayout get_set_layout(const descriptor_set_layout_desc & desc);
+        VkPipelineLayout get_pipeline_layout(const pipeline_layout_desc & desc);
+        VkPipelineLayout get_pipeline_layout(std::initializer_list<const module_info *> modules) { return get_pipeline_layout(merge_pipeline_layout(modules)); }
+
+        std::vector<VkDescriptorSetLayout> get_set_layouts() const;
+        std::vector<VkPipelineLayout> get_pipeline_layouts() const;
+    };
+}
+
+namespace spvi
+{
+    // The numeric type which occupies a single location of a stage interface. Matrices, arrays and structures are broken down into one slot per location.
+    struct interface_slot
+    {
+        uint32_t location;
+        type::number_kind elem_kind;
+        uint32_t elem_width;        // Width in bits of each component
+        uint32_t component_count;   // One to four components
+    };
+
+    // The inputs or outputs of an entry point, reduced to one slot per location, sorted by location, along with a hash of the slots.
+    // Signatures can be built once per shader and compared many times, without visiting the types they were built from.
+    struct interface_signature
+    {
+        std::vector<interface_slot> slots;
+        uint64_t hash = 0;
+    };
+
+    bool operator == (const interface_slot & a, const interface_slot & b);
+    bool operator == (const interface_signature & a, const interface_signature & b);
+    inline bool operator != (const interface_slot & a, const interface_slot & b) { return !(a == b); }
+    inline bool operator != (const interface_signature & a, const interface_signature & b) { return !(a == b); }
+
+    // Builds the signature of a list of interface variables, which should be the inputs or outputs of an entry point. If per_vertex is set, the outermost
+    // array of each variable is removed, as for the inputs of tessellation and geometry shaders and the outputs of tessellation control shaders,
+    // while variables which are not arrays are assumed to be per-patch and kept whole.
+    // Throws std::logic_error if a variable contains opaque types or runtime arrays, which cannot appear in a stage interface.
+    interface_signature get_interface_signature(const std::vector<variable_info> & variables, bool per_vertex = false);
+
+    // Builds the signature of the inputs or outputs of an entry point, removing the per-vertex arrays of the stages which have them. Per-patch variables
+    // are not distinguished by reflection, so a per-patch array is treated as though it were per-vertex.
+    interface_signature get_input_signature(const entry_point_info & entry_point);
+    interface_signature get_output_signature(const entry_point_info & entry_point);
+
+    // True if the outputs of one stage satisfy the inputs of the next. Every input location must be written by an output of the same component type and width,
+    // with at least as many components as the input reads. Outputs which are not read by the next stage are permitted.
+    bool is_interface_compatible(const interface_signature & outputs, const interface_signature & inputs);
+
+    // Checks the compatibility of every pairing of a producing stage with a consuming stage, returning output_count * input_count results,
+    // where the result for outputs[i] and inputs[j] is at index i * input_count + j, and is 1 if compatible and 0 otherwise. Identical signatures are
+    // only compared once, so the cost of large permutation matrices is dominated by writing the results rather than comparing interfaces.
+    std::vector<uint8_t> check_interface_compatibility(const interface_signature * outputs, size_t output_count, const interface_signature * inputs, size_t input_count);
+    inline std::vector<uint8_t> check_interface_compatibility(const std::vector<interface_signature> & outputs, const std::vector<interface_signature> & inputs) { return check_interface_compatibility(outputs.data(), outputs.size(), inputs.data(), inputs.size()); }
+}
+
+namespace spvi
+{
+    // How the components of a vertex attribute are stored in a vertex buffer. Floating point inputs can be read from half floats or normalized integers,
+    // and integer inputs from narrower integers of the same signedness, while 64-bit inputs must be stored natively. Three component 8 and 16-bit attributes are stored with a fourth component
+    // of padding, as the three component formats are not required to be supported for vertex buffers.
+    enum class vertex_storage { native, float16, unorm8, snorm8, unorm16, snorm16, int8, int16 };
+
+    // The storage of the vertex attribute at a given location, for every location which does not use native storage
+    struct vertex_attribute_storage
+    {
+        uint32_t location;
+        vertex_storage storage;
+    };
+
+    // The vertex bindings and attributes needed to supply the inputs of a vertex shader
+    struct vertex_input_layout
+    {
+        std::vector<VkVertexInputBindingDescription> bindings;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+
+        // The returned structure refers to this object's bindings and attributes, and is only valid for as long as they are
+        VkPipelineVertexInputStateCreateInfo get_create_info() const { return {VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr, 0, 
+            static_cast<uint32_t>(bindings.size()), bindings.data(), static_cast<uint32_t>(attributes.size()), attributes.data()}; }
+    };
+
+    // Determines the format of a vertex attribute which supplies a scalar or vector input, or one column of a matrix input, when stored as given.
+    // Throws std::logic_error if the storage cannot supply the input, such as normalized integers for an integer input, or anything but native storage for a 64-bit input.
+    VkFormat get_vertex_format(const type::numeric & input, vertex_storage storage = vertex_storage::native);
+
+    // Size in bytes of one vertex attribute of a format returned by get_vertex_format
+    uint32_t get_vertex_format_size(VkFormat format);
+
+    // Describes the vertex attributes which supply the inputs of a vertex shader. Matrix and array inputs are expanded into one attribute per location.
+    // If interleaved is set, every attribute is placed in binding 0, ordered by decreasing component size so that no padding is needed between them,
+    // giving the smallest stride possible with each attribute aligned to its components. Otherwise, each attribute is given its own binding,
+    // numbered in order of location. Throws std::logic_error if the entry point is not a vertex shader, or if a storage cannot supply its input.
+    vertex_input_layout get_vertex_input_layout(const entry_point_info & vertex_stage, const vertex_attribute_storage * storages, size_t storage_count, bool interleaved = true);
+    inline vertex_input_layout get_vertex_input_layout(const entry_point_info & vertex_stage, const std::vector<vertex_attribute_storage> & storages = {}, bool interleaved = true) { return get_vertex_input_layout(vertex_stage, storages.data(), storages.size(), interleaved); }
+}
+
+namespace std
+{
+    template<> struct hash<spvi::interface_signature> { size_t operator() (const spvi::interface_signature & s) const { return static_cast<size_t>(s.hash); } };
+}